@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "lexer.h"
+#include "source.h"
+#include "symbol.h"
+
+// lexer throughput in MB/s, over a file or a generated module of about 16M.
+//
+//   basilisk_lexbench [--iterations=N] [--threads=N] [file.bsl]
+
+#define GENERATED_SIZE (16 * 1024 * 1024)
+
+static void generate(Source* source) {
+    char* data = malloc(GENERATED_SIZE + 256);
+    if (!data) {
+        error_and_die("cannot allocate memory");
+    }
+
+    size_t size = 0;
+
+    for (int i = 0; size < GENERATED_SIZE; i++) {
+        size += sprintf(data + size,
+                        "# helper number %d, generated\n"
+                        "def helper_%d[count, offset] -> {\n"
+                        "    let [scaled] -> { scaled -> count * %d + offset - 1.25 }\n"
+                        "    if (scaled <= -3) { scaled } else { helper_%d[count - 1, offset] }\n"
+                        "}\n\n",
+                        i, i, i % 97, i);
+    }
+
+    source->data = data;
+    source->size = size;
+    source->mapped = false;
+}
+
+static double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char** argv) {
+    const char* filepath = NULL;
+    int iterations = 10;
+    int threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = atoi(argv[i] + 13);
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "-", 1) == 0 && argv[i][1]) {
+            error_and_die("unknown option: %s", argv[i]);
+        } else {
+            filepath = argv[i];
+        }
+    }
+
+    if (iterations < 1 || threads < 1) {
+        error_and_die("iterations and threads must be positive");
+    }
+
+    Source source;
+    if (filepath) {
+        source_open(&source, filepath);
+    } else {
+        generate(&source);
+    }
+
+    // the first run interns every identifier, later ones only look them up.
+    double best = 0;
+    int tokens_size = 0;
+
+    for (int i = 0; i <= iterations; i++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        Tokens tokens;
+        lexer_lex_parallel(source.data, source.size, threads, &tokens);
+
+        double seconds = seconds_since(&start);
+        if (i > 0 && (best == 0 || seconds < best)) {
+            best = seconds;
+        }
+
+        tokens_size = tokens.size;
+        tokens_free(&tokens);
+    }
+
+    printf("%zu bytes, %d tokens, %d threads: %.1f MB/s\n",
+           source.size, tokens_size, threads, source.size / best / (1024 * 1024));
+
+    source_close(&source);
+    symbols_free();
+
+    return 0;
+}
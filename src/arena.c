@@ -0,0 +1,139 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "common.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+struct ArenaChunk_t {
+    ArenaChunk* next;
+
+    size_t size;
+    size_t cap;
+
+    // start of the most recent allocation, the only one that can grow in place.
+    size_t last;
+
+    alignas(max_align_t) unsigned char data[];
+};
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaChunk* arena_push_chunk(Arena* arena, size_t size) {
+    size_t cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + cap);
+    if (!chunk) {
+        error_and_die("cannot allocate memory");
+    }
+
+    chunk->next = arena->chunks;
+    chunk->size = 0;
+    chunk->cap = cap;
+    chunk->last = 0;
+
+    arena->chunks = chunk;
+    arena->chunks_size++;
+
+    return chunk;
+}
+
+void arena_init(Arena* arena) {
+    assert(arena != NULL);
+
+    arena->chunks = NULL;
+    arena->chunks_size = 0;
+    arena->bytes_allocated = 0;
+}
+
+void arena_free(Arena* arena) {
+    assert(arena != NULL);
+
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena_init(arena);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    assert(arena != NULL);
+
+    size = align_up(size ? size : 1);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (!chunk || chunk->cap - chunk->size < size) {
+        chunk = arena_push_chunk(arena, size);
+    }
+
+    chunk->last = chunk->size;
+    chunk->size += size;
+
+    arena->bytes_allocated += size;
+
+    return chunk->data + chunk->last;
+}
+
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    assert(arena != NULL);
+
+    if (!ptr) {
+        return arena_alloc(arena, new_size);
+    }
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk && ptr == chunk->data + chunk->last) {
+        size_t size = align_up(new_size ? new_size : 1);
+
+        if (chunk->last + size <= chunk->cap) {
+            arena->bytes_allocated += chunk->last + size - chunk->size;
+            chunk->size = chunk->last + size;
+
+            return ptr;
+        }
+
+        // a big array that has the chunk to itself, let the system allocator move it.
+        if (chunk->last == 0) {
+            chunk = realloc(chunk, sizeof(ArenaChunk) + size);
+            if (!chunk) {
+                error_and_die("cannot allocate memory");
+            }
+
+            arena->bytes_allocated += size - chunk->size;
+            arena->chunks = chunk;
+
+            chunk->size = size;
+            chunk->cap = size;
+
+            return chunk->data;
+        }
+    }
+
+    void* result = arena_alloc(arena, new_size);
+    memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+
+    return result;
+}
+
+void* arena_reserve(Arena* arena, void* items, int size, int* cap, size_t item_size) {
+    if (size < *cap) {
+        return items;
+    }
+
+    int new_cap = *cap ? *cap * 2 : 4;
+    items = arena_realloc(arena, items, item_size * *cap, item_size * new_cap);
+
+    *cap = new_cap;
+
+    return items;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef struct ArenaChunk_t ArenaChunk;
+
+// region allocator, everything allocated from it is released at once by arena_free.
+typedef struct {
+    ArenaChunk* chunks;
+
+    size_t chunks_size;
+    size_t bytes_allocated;
+} Arena;
+
+void arena_init(Arena* arena);
+void arena_free(Arena* arena);
+
+void* arena_alloc(Arena* arena, size_t size);
+
+// resizes the most recent allocation in place when possible, copies otherwise.
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+
+// makes room for one more item in a dynamic array living in the arena, growing it geometrically.
+void* arena_reserve(Arena* arena, void* items, int size, int* cap, size_t item_size);
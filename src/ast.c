@@ -1,188 +1,304 @@
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ast.h"
 #include "common.h"
 
-void function_call_free(FunctionCall* funcall) {
-    assert(funcall != NULL);
-
-    if (funcall->args) {
-        for (int i = 0; i < funcall->args_size; i++) {
-            expression_free(funcall->args[i]);
-        }
-
-        free(funcall->args);
-    }
-}
-
-void record_creation_free(RecordCreation* record_creation) {
-    assert(record_creation != NULL);
-
-    if (record_creation->args) {
-        for (int i = 0; i < record_creation->args_size; i++) {
-            expression_free(record_creation->args[i]);
-        }
-
-        free(record_creation->args);
-    }
-}
-
 BinaryExpression binary_expression_make(BinaryExpressionType type, Expression* lhs, Expression* rhs) {
     return (BinaryExpression) {
         .type = type,
         .lhs = lhs,
         .rhs = rhs,
+        .quickening = QUICK_NONE,
+        .deopts = 0,
     };
 }
 
-void binary_expression_free(BinaryExpression* binary) {
-    expression_free(binary->lhs);
-    expression_free(binary->rhs);
+Expression* expression_make(Arena* arena) {
+    return arena_alloc(arena, sizeof(Expression));
+}
+
+Block* block_make(Arena* arena) {
+    Block* block = arena_alloc(arena, sizeof(Block));
+
+    block->children = NULL;
+    block->children_size = 0;
+    block->children_cap = 0;
+
+    return block;
 }
 
-Expression* expression_make() {
-    Expression* expr = malloc(sizeof(Expression));
-    if (!expr) {
-        error_and_die("cannot allocate memory");
+int record_find_field(Record* record, Symbol symbol) {
+    for (int i = 0; i < record->fields_size; i++) {
+        if (record->fields[i].symbol == symbol) {
+            return i;
+        }
     }
 
-    return expr;
+    return -1;
 }
 
-void expression_free(Expression* expr) {
-    assert(expr != NULL);
+void module_index(Module* module) {
+    assert(module != NULL);
+
+    symbol_map_init(&module->records_index);
+    symbol_map_init(&module->fundecls_index);
+
+    for (int i = 0; i < module->records_size; i++) {
+        Record* record = &module->records[i];
+
+        if (!symbol_map_insert(&module->records_index, record->symbol, i)) {
+            error_and_die("duplicate record: "SPAN_FMT, SPAN_ARG(record->id));
+        }
 
-    switch (expr->type) {
-        case EXPR_PRIMARY:
-            switch (expr->as.primary.type) {
-                case VAL_FUNCALL:
-                    function_call_free(&expr->as.primary.as.funcall);
-                    break;
-                case VAL_RECORD_CREATION:
-                    record_creation_free(&expr->as.primary.as.record_creation);
-                    break;
-                default:
-                    break;
+        for (int j = 0; j < record->fields_size; j++) {
+            if (record_find_field(record, record->fields[j].symbol) != j) {
+                error_and_die("duplicate field: "SPAN_FMT" in record: "SPAN_FMT, SPAN_ARG(record->fields[j].id), SPAN_ARG(record->id));
             }
+        }
+    }
 
-            free(expr);
-            break;
-        case EXPR_BINARY:
-            binary_expression_free(&expr->as.binary);
-            free(expr);
-            break;
+    for (int i = 0; i < module->fundecls_size; i++) {
+        FunctionDeclaration* fundecl = &module->fundecls[i];
+
+        if (fundecl->symbol == SYM_PRINT) {
+            error_and_die("cannot redefine builtin function: "SPAN_FMT, SPAN_ARG(fundecl->id));
+        }
+
+        if (!symbol_map_insert(&module->fundecls_index, fundecl->symbol, i)) {
+            error_and_die("duplicate function: "SPAN_FMT, SPAN_ARG(fundecl->id));
+        }
     }
 }
 
-void assignment_free(Assignment* assignment) {
-    assert(assignment != NULL);
+FunctionDeclaration* module_find_fundecl(Module* module, Symbol symbol) {
+    int index = symbol_map_get(&module->fundecls_index, symbol);
+    if (index < 0)
+        return NULL;
 
-    expression_free(assignment->expr);
+    return &module->fundecls[index];
 }
 
-void let_block_free(LetBlock* letblock) {
-    assert(letblock != NULL);
+Record* module_find_record(Module* module, Symbol symbol) {
+    int index = symbol_map_get(&module->records_index, symbol);
+    if (index < 0)
+        return NULL;
 
-    if (letblock->ids) {
-        free(letblock->ids);
-    }
+    return &module->records[index];
+}
 
-    if (letblock->assignments) {
-        for (int i = 0; i < letblock->assignments_size; i++) {
-            assignment_free(&letblock->assignments[i]);
-        }
+static void print_indent(int depth) {
+    for (int i = 0; i < depth; i++) {
+        printf("    ");
+    }
+}
 
-        free(letblock->assignments);
+static const char* binary_operator(BinaryExpressionType type) {
+    switch (type) {
+        case BIN_ADD: return "+";
+        case BIN_SUB: return "-";
+        case BIN_MUL: return "*";
+        case BIN_DIV: return "/";
+        case BIN_EQU: return "==";
+        case BIN_NEQU: return "!=";
+        case BIN_GT: return ">";
+        case BIN_LT: return "<";
+        case BIN_GTEQ: return ">=";
+        case BIN_LTEQ: return "<=";
+        case BIN_AND: return "&&";
+        case BIN_OR: return "||";
     }
+
+    error_and_die("unreachable");
 }
 
-Block* block_make() {
-    Block* block = malloc(sizeof(Block));
-    if (!block) {
-        error_and_die("cannot allocate memory");
+// the lexer only takes plain decimals with a fractional part. folding can produce
+// values that have no such literal, those are written as a division giving them.
+static void print_float(double value) {
+    if (isnan(value)) {
+        printf("(0.0 / 0.0)");
+        return;
     }
 
-    block->children = NULL;
-    block->children_size = 0;
-    block->children_cap = 0;
+    if (isinf(value)) {
+        printf(value > 0 ? "(1.0 / 0.0)" : "(-1.0 / 0.0)");
+        return;
+    }
 
-    return block;
-}
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "%.17g", value);
 
-void block_free(Block* block) {
-    assert(block != NULL);
+    if (strchr(buffer, 'e')) {
+        // spelled out without the exponent, with as few decimals as read back the same.
+        for (int precision = 1; precision < 400; precision++) {
+            snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
 
-    if (block->children) {
-        for (int i = 0; i < block->children_size; i++) {
-            statement_free(&block->children[i]);
+            if (strtod(buffer, NULL) == value) {
+                break;
+            }
         }
+    } else if (!strchr(buffer, '.')) {
+        strcat(buffer, ".0");
+    }
+
+    printf("%s", buffer);
+}
 
-        free(block->children);
+static void print_expression(Expression* expression);
+
+// operands are parenthesized, the printed tree reads back the same regardless of precedence.
+static void print_operand(Expression* expression) {
+    if (expression->type == EXPR_BINARY) {
+        printf("(");
+        print_expression(expression);
+        printf(")");
+    } else {
+        print_expression(expression);
     }
+}
 
-    free(block);
+static void print_arguments(Expression** args, int args_size) {
+    for (int i = 0; i < args_size; i++) {
+        if (i > 0) {
+            printf(", ");
+        }
+        print_expression(args[i]);
+    }
 }
 
-void if_statement_free(IfStatement* ifstatement) {
-    assert(ifstatement != NULL);
+static void print_expression(Expression* expression) {
+    if (expression->type == EXPR_BINARY) {
+        print_operand(expression->as.binary.lhs);
+        printf(" %s ", binary_operator(expression->as.binary.type));
+        print_operand(expression->as.binary.rhs);
+        return;
+    }
 
-    expression_free(ifstatement->expr);
+    Value* value = &expression->as.primary;
 
-    block_free(ifstatement->true_block);
-    block_free(ifstatement->false_block);
+    switch (value->type) {
+        case VAL_INT:
+            printf("%ld", value->as.integer);
+            break;
+        case VAL_FLOAT:
+            print_float(value->as.floating);
+            break;
+        case VAL_IDENT:
+            printf(SPAN_FMT, SPAN_ARG(value->as.identifier.id));
+            break;
+        case VAL_FUNCALL:
+            printf(SPAN_FMT"[", SPAN_ARG(value->as.funcall.id));
+            print_arguments(value->as.funcall.args, value->as.funcall.args_size);
+            printf("]");
+            break;
+        case VAL_RECORD_CREATION:
+            printf("record "SPAN_FMT" { ", SPAN_ARG(value->as.record_creation.id));
+            print_arguments(value->as.record_creation.args, value->as.record_creation.args_size);
+            printf(" }");
+            break;
+        case VAL_FIELD_ACCESS:
+            print_operand(value->as.field_access.expr);
+            printf("."SPAN_FMT, SPAN_ARG(value->as.field_access.field));
+            break;
+    }
 }
 
-void statement_free(Statement* statement) {
-    assert(statement != NULL);
+static void print_block(Block* block, int depth);
 
+static void print_statement(Statement* statement, int depth) {
     switch (statement->type) {
-        case STMT_LETBLOCK:
-            let_block_free(&statement->as.letblock);
+        case STMT_LETBLOCK: {
+            LetBlock* letblock = &statement->as.letblock;
+
+            printf("let [");
+            for (int i = 0; i < letblock->ids_size; i++) {
+                if (i > 0) {
+                    printf(", ");
+                }
+                printf(SPAN_FMT, SPAN_ARG(letblock->ids[i].id));
+            }
+            printf("] -> {\n");
+
+            for (int i = 0; i < letblock->assignments_size; i++) {
+                print_indent(depth + 1);
+                printf(SPAN_FMT" -> ", SPAN_ARG(letblock->assignments[i].id));
+                print_expression(letblock->assignments[i].expr);
+                printf(i < letblock->assignments_size - 1 ? ",\n" : "\n");
+            }
+
+            print_indent(depth);
+            printf("}");
             break;
+        }
         case STMT_IF:
-            if_statement_free(&statement->as.ifstatement);
+            printf("if ");
+            print_expression(statement->as.ifstatement.expr);
+            printf(" ");
+            print_block(statement->as.ifstatement.true_block, depth);
+            printf(" else ");
+            print_block(statement->as.ifstatement.false_block, depth);
             break;
         case STMT_EXPRESSION:
-            expression_free(statement->as.expression);
+            print_expression(statement->as.expression);
             break;
     }
 }
 
-void function_declaration_free(FunctionDeclaration* fundecl) {
-    assert(fundecl != NULL);
+static void print_block(Block* block, int depth) {
+    printf("{\n");
 
-    if (fundecl->args) {
-        free(fundecl->args);
+    for (int i = 0; i < block->children_size; i++) {
+        print_indent(depth + 1);
+        print_statement(&block->children[i], depth + 1);
+        printf("\n");
     }
 
-    block_free(fundecl->block);
+    print_indent(depth);
+    printf("}");
 }
 
-void record_free(Record* record) {
-    assert(record != NULL);
+void module_print(Module* module) {
+    assert(module != NULL);
+
+    for (int i = 0; i < module->records_size; i++) {
+        Record* record = &module->records[i];
+
+        printf("record "SPAN_FMT" {\n", SPAN_ARG(record->id));
+        for (int j = 0; j < record->fields_size; j++) {
+            printf("    "SPAN_FMT"%s\n", SPAN_ARG(record->fields[j].id), j < record->fields_size - 1 ? "," : "");
+        }
+        printf("}\n\n");
+    }
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        FunctionDeclaration* fundecl = &module->fundecls[i];
 
-    if (record->fields) {
-        free(record->fields);
+        printf("def "SPAN_FMT"[", SPAN_ARG(fundecl->id));
+        for (int j = 0; j < fundecl->args_size; j++) {
+            if (j > 0) {
+                printf(", ");
+            }
+            printf(SPAN_FMT, SPAN_ARG(fundecl->args[j].id));
+        }
+        printf("] -> ");
+        print_block(fundecl->block, 0);
+        printf(i < module->fundecls_size - 1 ? "\n\n" : "\n");
     }
 }
 
 void module_free(Module* module) {
     assert(module != NULL);
 
-    if (module->fundecls) {
-        for (int i = 0; i < module->fundecls_size; i++) {
-            function_declaration_free(&module->fundecls[i]);
-        }
+    symbol_map_free(&module->records_index);
+    symbol_map_free(&module->fundecls_index);
 
-        free(module->fundecls);
-    }
+    arena_free(module->arena);
 
-    if (module->records) {
-        for (int i = 0; i < module->records_size; i++) {
-            record_free(&module->records[i]);
-        }
-
-        free(module->records);
-    }
+    module->records = NULL;
+    module->records_size = 0;
+    module->fundecls = NULL;
+    module->fundecls_size = 0;
 }
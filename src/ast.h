@@ -1,30 +1,52 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "arena.h"
 #include "span.h"
+#include "symbol.h"
 
 typedef struct Expression_t Expression;
+typedef struct ObjInt_t ObjInt;
 
 typedef struct {
     Span id;
+    Symbol symbol;
+    int slot; // filled in by the resolver
+} Identifier;
+
+typedef struct {
+    Span id;
+    Symbol symbol;
 
     Expression** args;
     int args_size;
     int args_cap;
 } FunctionCall;
 
-void function_call_free(FunctionCall* funcall);
-
 typedef struct {
     Span id;
+    Symbol symbol;
 
     Expression** args;
     int args_size;
     int args_cap;
 } RecordCreation;
 
-void record_creation_free(RecordCreation* record_creation);
+typedef struct Record_t Record;
+
+typedef struct {
+    Expression* expr;
+
+    Span field;
+    Symbol symbol;
+
+    // monomorphic inline cache, the shape last seen at this site and where the field lives in it.
+    // the resolver fills it in up front when only one record declares the field.
+    Record* cached_shape;
+    int cached_offset;
+} FieldAccess;
 
 typedef enum {
     VAL_INT,
@@ -32,17 +54,22 @@ typedef enum {
     VAL_IDENT,
     VAL_FUNCALL,
     VAL_RECORD_CREATION,
+    VAL_FIELD_ACCESS,
 } ValueType;
 
 typedef struct {
     ValueType type;
 
     union {
-        int64_t integer;
+        struct {
+            int64_t integer;
+            ObjInt* boxed; // integers too wide to be inline, boxed once in the module arena
+        };
         double floating;
-        Span identifier;
+        Identifier identifier;
         FunctionCall funcall;
         RecordCreation record_creation;
+        FieldAccess field_access;
     } as;
 } Value;
 
@@ -61,15 +88,26 @@ typedef enum {
     BIN_OR,
 } BinaryExpressionType;
 
+// operand types a binary node has settled on, the tree walker rewrites a node
+// into the specialised variant after its first evaluation.
+typedef enum {
+    QUICK_NONE,    // not evaluated yet, or just deoptimized
+    QUICK_INT,     // both operands were inline ints
+    QUICK_FLOAT,   // both operands were floats
+    QUICK_GENERIC, // deoptimized too often, stays on the generic path
+} Quickening;
+
 typedef struct {
     BinaryExpressionType type;
 
     Expression* lhs;
     Expression* rhs;
+
+    Quickening quickening;
+    int deopts;
 } BinaryExpression;
 
 BinaryExpression binary_expression_make(BinaryExpressionType type, Expression* lhs, Expression* rhs);
-void binary_expression_free(BinaryExpression* binary);
 
 typedef enum {
     EXPR_PRIMARY,
@@ -85,18 +123,17 @@ struct Expression_t {
     } as;
 };
 
-Expression* expression_make();
-void expression_free(Expression* expr);
+Expression* expression_make(Arena* arena);
 
 typedef struct {
     Span id;
+    Symbol symbol;
+    int slot;
     Expression* expr;
 } Assignment;
 
-void assignment_free(Assignment* assignment);
-
 typedef struct {
-    Span* ids;
+    Identifier* ids;
     int ids_size;
     int ids_cap;
 
@@ -105,8 +142,6 @@ typedef struct {
     int assignments_cap;
 } LetBlock;
 
-void let_block_free(LetBlock* letblock);
-
 typedef struct Statement_t Statement;
 
 typedef struct Block_t {
@@ -115,8 +150,7 @@ typedef struct Block_t {
     int children_cap;
 } Block;
 
-Block* block_make();
-void block_free(Block* block);
+Block* block_make(Arena* arena);
 
 typedef struct {
     Expression* expr;
@@ -125,8 +159,6 @@ typedef struct {
     Block* false_block;
 } IfStatement;
 
-void if_statement_free(IfStatement* ifstatement);
-
 typedef enum {
     STMT_LETBLOCK,
     STMT_IF,
@@ -143,31 +175,37 @@ struct Statement_t {
     } as;
 };
 
-void statement_free(Statement* statement);
-
 typedef struct {
     Span id;
+    Symbol symbol;
 
-    Span* args;
+    Identifier* args;
     int args_size;
     int args_cap;
 
+    int slots_size; // arguments come first, then every let binding
+
     Block* block;
-} FunctionDeclaration;
 
-void function_declaration_free(FunctionDeclaration* fundecl);
+    bool pure; // never prints, not even through a call, filled in by analyze_effects
+} FunctionDeclaration;
 
-typedef struct {
+struct Record_t {
     Span id;
+    Symbol symbol;
 
-    Span* fields;
+    Identifier* fields; // the slot of a field is its offset in every instance
     int fields_size;
     int fields_cap;
-} Record;
+};
 
-void record_free(Record* record);
+// returns the offset of the field in instances of the record, or -1.
+int record_find_field(Record* record, Symbol symbol);
 
+// every node of a module, as well as its tokens, lives in the arena.
 typedef struct {
+    Arena* arena;
+
     Record* records;
     int records_size;
     int records_cap;
@@ -175,6 +213,20 @@ typedef struct {
     FunctionDeclaration* fundecls;
     int fundecls_size;
     int fundecls_cap;
+
+    // symbol -> index into records / fundecls, filled in by module_index.
+    SymbolMap records_index;
+    SymbolMap fundecls_index;
 } Module;
 
+// builds the lookup tables of a freshly parsed module, dies on duplicate definitions.
+// called by the resolver.
+void module_index(Module* module);
+
+FunctionDeclaration* module_find_fundecl(Module* module, Symbol symbol);
+Record* module_find_record(Module* module, Symbol symbol);
+
+// writes the module back out as source, e.g. to inspect what the optimizer did.
+void module_print(Module* module);
+
 void module_free(Module* module);
@@ -0,0 +1,285 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "basilisk.h"
+#include "common.h"
+#include "interpreter.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "source.h"
+
+struct BslModule_t {
+    Source source; // spans in the tree point into it
+    Parser parser; // only while loading
+    Resolver resolver; // only while loading
+    Arena arena;
+    Module module;
+};
+
+struct BslContext_t {
+    BslModule* module;
+    Interpreter interpreter;
+};
+
+// handles are the function declarations themselves, only ever read.
+struct BslFunction_t {
+    FunctionDeclaration fundecl;
+};
+
+// the symbol table is process wide, so only one module is lexed and resolved at a time.
+static pthread_mutex_t s_load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local char s_error[sizeof(((ErrorHandler*) NULL)->message)];
+
+static void set_error(const char* fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(s_error, sizeof(s_error), fmt, args);
+    va_end(args);
+}
+
+static void push_handler(ErrorHandler* handler) {
+    handler->previous = error_handler;
+    error_handler = handler;
+}
+
+static void pop_handler(ErrorHandler* handler) {
+    error_handler = handler->previous;
+}
+
+BslValue bsl_int(int64_t value) {
+    return (BslValue) {
+        .type = BSL_INT,
+        .as.i = value,
+    };
+}
+
+BslValue bsl_float(double value) {
+    return (BslValue) {
+        .type = BSL_FLOAT,
+        .as.f = value,
+    };
+}
+
+// reads the file, or copies text when filepath is NULL, then builds the module.
+static BslStatus load(const char* filepath, const char* text, BslModule** result) {
+    BslModule* module = malloc(sizeof(BslModule));
+    if (!module) {
+        set_error("cannot allocate memory");
+        return BSL_ERROR_MEMORY;
+    }
+
+    module->source.data = NULL;
+    module->parser = (Parser) {0};
+    module->resolver = (Resolver) {0};
+    module->module = (Module) {0};
+    arena_init(&module->arena);
+
+    volatile BslStatus failure = BSL_ERROR_IO;
+
+    ErrorHandler handler;
+    push_handler(&handler);
+
+    if (setjmp(handler.jump)) {
+        pop_handler(&handler);
+
+        if (failure == BSL_ERROR_LOAD) {
+            pthread_mutex_unlock(&s_load_lock);
+        }
+
+        set_error("%s", handler.message);
+
+        parser_deinit(&module->parser);
+        resolver_deinit(&module->resolver);
+
+        // once parsed, the module owns the arena along with its indexes.
+        if (module->module.arena) {
+            module_free(&module->module);
+        } else {
+            arena_free(&module->arena);
+        }
+
+        if (module->source.data) {
+            source_close(&module->source);
+        }
+        free(module);
+
+        return failure;
+    }
+
+    if (filepath) {
+        source_open(&module->source, filepath);
+    } else {
+        source_copy(&module->source, text, strlen(text));
+    }
+
+    pthread_mutex_lock(&s_load_lock);
+    failure = BSL_ERROR_LOAD;
+
+    Lexer lexer;
+    lexer_init(&lexer, module->source.data, module->source.size);
+
+    parser_init(&module->parser, &module->arena, &lexer);
+    module->module = parse_module(&module->parser);
+    parser_deinit(&module->parser);
+
+    resolver_init(&module->resolver, &module->module);
+    resolve_module(&module->resolver);
+    resolver_deinit(&module->resolver);
+
+    optimize_module(&module->module, OPT_LEVEL_1);
+
+    pop_handler(&handler);
+    pthread_mutex_unlock(&s_load_lock);
+
+    *result = module;
+
+    return BSL_OK;
+}
+
+BslStatus bsl_module_load(const char* source, BslModule** module) {
+    assert(source != NULL);
+    assert(module != NULL);
+
+    return load(NULL, source, module);
+}
+
+BslStatus bsl_module_load_file(const char* filepath, BslModule** module) {
+    assert(filepath != NULL);
+    assert(module != NULL);
+
+    return load(filepath, NULL, module);
+}
+
+void bsl_module_free(BslModule* module) {
+    assert(module != NULL);
+
+    module_free(&module->module);
+    source_close(&module->source);
+    free(module);
+}
+
+BslStatus bsl_module_function(BslModule* module, const char* name, BslFunction** function) {
+    assert(module != NULL);
+    assert(name != NULL);
+    assert(function != NULL);
+
+    // compares names rather than interning, which would write to the symbol table.
+    Span span = span_from_cstr(name);
+
+    for (int i = 0; i < module->module.fundecls_size; i++) {
+        if (span_equals(module->module.fundecls[i].id, span)) {
+            *function = (BslFunction*) &module->module.fundecls[i];
+            return BSL_OK;
+        }
+    }
+
+    set_error("no such function: %s", name);
+
+    return BSL_ERROR_NOT_FOUND;
+}
+
+int bsl_function_arity(BslFunction* function) {
+    assert(function != NULL);
+
+    return function->fundecl.args_size;
+}
+
+BslStatus bsl_context_new(BslModule* module, BslContext** context) {
+    assert(module != NULL);
+    assert(context != NULL);
+
+    BslContext* result = malloc(sizeof(BslContext));
+    if (!result) {
+        set_error("cannot allocate memory");
+        return BSL_ERROR_MEMORY;
+    }
+
+    result->module = module;
+
+    interpreter_init(&result->interpreter, &module->module);
+    result->interpreter.shared = true;
+
+    *context = result;
+
+    return BSL_OK;
+}
+
+void bsl_context_free(BslContext* context) {
+    assert(context != NULL);
+
+    interpreter_deinit(&context->interpreter);
+    free(context);
+}
+
+void bsl_context_set_heap_limit(BslContext* context, size_t limit) {
+    assert(context != NULL);
+
+    context->interpreter.heap.limit = limit;
+}
+
+BslStatus bsl_call(BslContext* context, BslFunction* function, const BslValue* args, int args_size, BslValue* result) {
+    assert(context != NULL);
+    assert(function != NULL);
+    assert(args != NULL || args_size == 0);
+    assert(result != NULL);
+
+    FunctionDeclaration* fundecl = &function->fundecl;
+    Interpreter* interpreter = &context->interpreter;
+
+    if (args_size != fundecl->args_size) {
+        set_error(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(fundecl->id), fundecl->args_size, args_size);
+        return BSL_ERROR_ARITY;
+    }
+
+    ErrorHandler handler;
+    push_handler(&handler);
+
+    if (setjmp(handler.jump)) {
+        pop_handler(&handler);
+
+        // the frames of the failed call are dropped, the collector reclaims what they held.
+        interpreter->frames_size = 0;
+
+        set_error("%s", handler.message);
+
+        return BSL_ERROR_RUNTIME;
+    }
+
+    Scope scope = interpreter_push_frame(interpreter, fundecl->slots_size);
+
+    for (int i = 0; i < args_size; i++) {
+        Object arg = args[i].type == BSL_FLOAT ? object_float(args[i].as.f) : heap_make_int(&interpreter->heap, args[i].as.i);
+        interpreter->frames[scope.base + i] = arg;
+    }
+
+    interpreter->stats.calls++;
+
+    Object object = execute_function_declaration(interpreter, fundecl, &scope);
+    interpreter_pop_frame(interpreter, &scope);
+
+    pop_handler(&handler);
+
+    if (object_is_int(object)) {
+        *result = bsl_int(object_as_int(object));
+    } else if (object_is_float(object)) {
+        *result = bsl_float(object_as_float(object));
+    } else {
+        set_error(SPAN_FMT" returned %s", SPAN_ARG(fundecl->id), object_is_void(object) ? "void" : "a record");
+        return BSL_ERROR_TYPE;
+    }
+
+    return BSL_OK;
+}
+
+const char* bsl_error(void) {
+    return s_error;
+}
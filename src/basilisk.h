@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// embedding api, built into libbasilisk. a module is loaded once and never changes
+// afterwards, then any number of threads call into it at once, each through a
+// context of its own. nothing here exits the process, failures are returned as a
+// status and described by bsl_error.
+
+typedef struct BslModule_t BslModule;
+typedef struct BslContext_t BslContext;
+typedef struct BslFunction_t BslFunction;
+
+typedef enum {
+    BSL_OK,
+    BSL_ERROR_MEMORY,    // an allocation failed
+    BSL_ERROR_IO,        // the source file cannot be read
+    BSL_ERROR_LOAD,      // the source does not lex, parse or resolve
+    BSL_ERROR_NOT_FOUND, // no function of that name
+    BSL_ERROR_ARITY,     // the wrong number of arguments
+    BSL_ERROR_RUNTIME,   // the call failed while running
+    BSL_ERROR_TYPE,      // the result is void or a record, which cannot leave its context
+} BslStatus;
+
+typedef enum {
+    BSL_INT,
+    BSL_FLOAT,
+} BslType;
+
+typedef struct {
+    BslType type;
+    union {
+        int64_t i;
+        double f;
+    } as;
+} BslValue;
+
+BslValue bsl_int(int64_t value);
+BslValue bsl_float(double value);
+
+// the source is copied, a file is mapped for as long as the module lives. loads on
+// different threads take turns.
+BslStatus bsl_module_load(const char* source, BslModule** module);
+BslStatus bsl_module_load_file(const char* filepath, BslModule** module);
+
+// every context of the module must be freed first.
+void bsl_module_free(BslModule* module);
+
+// looks a function up once for any number of calls on any thread, the handle
+// lives as long as the module.
+BslStatus bsl_module_function(BslModule* module, const char* name, BslFunction** function);
+int bsl_function_arity(BslFunction* function);
+
+// an interpreter with its own frames and heap, used by one thread at a time.
+BslStatus bsl_context_new(BslModule* module, BslContext** context);
+void bsl_context_free(BslContext* context);
+
+// zero means unbounded, a call crossing it fails with BSL_ERROR_RUNTIME.
+void bsl_context_set_heap_limit(BslContext* context, size_t limit);
+
+BslStatus bsl_call(BslContext* context, BslFunction* function, const BslValue* args, int args_size, BslValue* result);
+
+// describes the last failure on the calling thread.
+const char* bsl_error(void);
@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "common.h"
+
+void bytecode_function_emit(BytecodeFunction* function, uint8_t byte) {
+    assert(function != NULL);
+
+    if (function->code_size >= function->code_cap) {
+        function->code_cap = function->code_cap ? function->code_cap * 2 : 64;
+        function->code = realloc(function->code, sizeof(uint8_t) * function->code_cap);
+        if (!function->code) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    function->code[function->code_size++] = byte;
+}
+
+void bytecode_function_emit_u16(BytecodeFunction* function, uint16_t value) {
+    bytecode_function_emit(function, value & 0xff);
+    bytecode_function_emit(function, (value >> 8) & 0xff);
+}
+
+static bool constant_equals(Object* lhs, Object* rhs) {
+    // floats compare by bits, so -0.0 and 0.0 stay distinct.
+    if (lhs->bits == rhs->bits)
+        return true;
+
+    return object_is_boxed_int(*lhs) && object_is_boxed_int(*rhs) && object_as_int(*lhs) == object_as_int(*rhs);
+}
+
+int bytecode_function_add_constant(BytecodeFunction* function, Object constant) {
+    assert(function != NULL);
+
+    for (int i = 0; i < function->constants_size; i++) {
+        if (constant_equals(&function->constants[i], &constant)) {
+            return i;
+        }
+    }
+
+    if (function->constants_size > UINT16_MAX) {
+        error_and_die(SPAN_FMT": too many constants", SPAN_ARG(function->id));
+    }
+
+    if (function->constants_size >= function->constants_cap) {
+        function->constants_cap = function->constants_cap ? function->constants_cap * 2 : 8;
+        function->constants = realloc(function->constants, sizeof(Object) * function->constants_cap);
+        if (!function->constants) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    function->constants[function->constants_size] = constant;
+
+    return function->constants_size++;
+}
+
+int bytecode_function_add_field_access(BytecodeFunction* function, FieldAccess* field_access) {
+    assert(function != NULL);
+
+    if (function->field_accesses_size > UINT16_MAX) {
+        error_and_die(SPAN_FMT": too many field accesses", SPAN_ARG(function->id));
+    }
+
+    if (function->field_accesses_size >= function->field_accesses_cap) {
+        function->field_accesses_cap = function->field_accesses_cap ? function->field_accesses_cap * 2 : 8;
+        function->field_accesses = realloc(function->field_accesses, sizeof(FieldAccess*) * function->field_accesses_cap);
+        if (!function->field_accesses) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    function->field_accesses[function->field_accesses_size] = field_access;
+
+    return function->field_accesses_size++;
+}
+
+int bytecode_function_add_error(BytecodeFunction* function, const char* message) {
+    assert(function != NULL);
+
+    if (function->errors_size > UINT16_MAX) {
+        error_and_die(SPAN_FMT": too many errors", SPAN_ARG(function->id));
+    }
+
+    if (function->errors_size >= function->errors_cap) {
+        function->errors_cap = function->errors_cap ? function->errors_cap * 2 : 4;
+        function->errors = realloc(function->errors, sizeof(char*) * function->errors_cap);
+        if (!function->errors) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    function->errors[function->errors_size] = strdup(message);
+    if (!function->errors[function->errors_size]) {
+        error_and_die("cannot allocate memory");
+    }
+
+    return function->errors_size++;
+}
+
+void bytecode_function_free(BytecodeFunction* function) {
+    assert(function != NULL);
+
+    if (function->code) {
+        free(function->code);
+    }
+
+    if (function->constants) {
+        free(function->constants);
+    }
+
+    if (function->field_accesses) {
+        free(function->field_accesses);
+    }
+
+    for (int i = 0; i < function->errors_size; i++) {
+        free(function->errors[i]);
+    }
+
+    if (function->errors) {
+        free(function->errors);
+    }
+}
+
+void program_free(Program* program) {
+    assert(program != NULL);
+
+    if (program->functions) {
+        for (int i = 0; i < program->functions_size; i++) {
+            bytecode_function_free(&program->functions[i]);
+        }
+
+        free(program->functions);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ast.h"
+#include "object.h"
+
+typedef enum {
+    OP_CONST,       // u16 constant index
+    OP_LOAD,        // u16 slot
+    OP_STORE,       // u16 slot
+    OP_RESET,       // u16 slot, let bindings start out as integer zero
+    OP_POP,
+
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_EQU,
+    OP_NEQU,
+    OP_GT,
+    OP_LT,
+    OP_GTEQ,
+    OP_LTEQ,
+    OP_AND,
+    OP_OR,
+
+    OP_JUMP,        // u16 forward offset
+    OP_JUMP_IF_FALSE, // u16 forward offset
+
+    OP_CALL,        // u16 function index
+    OP_TAIL_CALL,   // u16 function index, replaces the current frame
+    OP_PRINT,
+    OP_RECORD,      // u16 record index
+    OP_GET_FIELD,   // u16 field access index, the access site doubles as the inline cache
+    OP_RETURN,
+    OP_ERROR,       // u16 error index, raised only once reached like in the tree walker
+} OpCode;
+
+typedef struct {
+    Span id;
+
+    int args_size;
+    int slots_size;
+    int stack_size;
+
+    uint8_t* code;
+    int code_size;
+    int code_cap;
+
+    Object* constants;
+    int constants_size;
+    int constants_cap;
+
+    FieldAccess** field_accesses;
+    int field_accesses_size;
+    int field_accesses_cap;
+
+    char** errors;
+    int errors_size;
+    int errors_cap;
+} BytecodeFunction;
+
+void bytecode_function_emit(BytecodeFunction* function, uint8_t byte);
+void bytecode_function_emit_u16(BytecodeFunction* function, uint16_t value);
+int bytecode_function_add_constant(BytecodeFunction* function, Object constant);
+int bytecode_function_add_field_access(BytecodeFunction* function, FieldAccess* field_access);
+int bytecode_function_add_error(BytecodeFunction* function, const char* message);
+void bytecode_function_free(BytecodeFunction* function);
+
+typedef struct {
+    Module* module;
+
+    BytecodeFunction* functions;
+    int functions_size;
+    int functions_cap;
+
+    int entry_point;
+} Program;
+
+void program_free(Program* program);
@@ -0,0 +1,591 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgen.h"
+#include "common.h"
+#include "object.h"
+
+// target of a block that returns from the function, calls in it are tail calls.
+#define TARGET_RETURN (-1)
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t cap;
+} Buffer;
+
+// where a value lives once it has been computed, a slot or a constant.
+typedef struct {
+    char text[64];
+} Operand;
+
+typedef struct {
+    Module* module;
+
+    Buffer statics; // boxed constants and field caches
+    Buffer code;    // function bodies
+
+    int statics_size;
+
+    FunctionDeclaration* fundecl;
+    int depth;
+
+    // temporaries come after the slots of the function in its frame.
+    int temps;
+    int temps_max;
+    bool uses_entry;
+
+    // only the functions main reaches and the records they use are emitted,
+    // anything else would be an unused static.
+    bool* functions_used;
+    bool* records_used;
+} CGen;
+
+static void buffer_vprintf(Buffer* buffer, const char* fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int size = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+
+    if (buffer->size + size + 1 > buffer->cap) {
+        while (buffer->size + size + 1 > buffer->cap) {
+            buffer->cap = buffer->cap ? buffer->cap * 2 : 4096;
+        }
+
+        buffer->data = realloc(buffer->data, buffer->cap);
+        if (!buffer->data) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    vsnprintf(buffer->data + buffer->size, size + 1, fmt, args);
+    buffer->size += size;
+}
+
+static void buffer_printf(Buffer* buffer, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    buffer_vprintf(buffer, fmt, args);
+    va_end(args);
+}
+
+static void buffer_free(Buffer* buffer) {
+    free(buffer->data);
+}
+
+// writes an indented line of a function body.
+static void line(CGen* gen, const char* fmt, ...) {
+    buffer_printf(&gen->code, "%*s", 4 * gen->depth, "");
+
+    va_list args;
+    va_start(args, fmt);
+    buffer_vprintf(&gen->code, fmt, args);
+    va_end(args);
+
+    buffer_printf(&gen->code, "\n");
+}
+
+static Operand operand(const char* fmt, ...) {
+    Operand operand;
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(operand.text, sizeof(operand.text), fmt, args);
+    va_end(args);
+
+    return operand;
+}
+
+static int push_temp(CGen* gen) {
+    int temp = gen->fundecl->slots_size + gen->temps++;
+    if (gen->temps > gen->temps_max) {
+        gen->temps_max = gen->temps;
+    }
+
+    return temp;
+}
+
+static const char* binary_name(BinaryExpressionType type) {
+    switch (type) {
+        case BIN_ADD: return "BIN_ADD";
+        case BIN_SUB: return "BIN_SUB";
+        case BIN_MUL: return "BIN_MUL";
+        case BIN_DIV: return "BIN_DIV";
+        case BIN_EQU: return "BIN_EQU";
+        case BIN_NEQU: return "BIN_NEQU";
+        case BIN_GT: return "BIN_GT";
+        case BIN_LT: return "BIN_LT";
+        case BIN_GTEQ: return "BIN_GTEQ";
+        case BIN_LTEQ: return "BIN_LTEQ";
+        case BIN_AND: return "BIN_AND";
+        case BIN_OR: return "BIN_OR";
+    }
+
+    error_and_die("unreachable");
+}
+
+static Operand gen_expression(CGen* gen, Expression* expression);
+static void gen_block(CGen* gen, Block* block, int target);
+
+static Operand gen_int(CGen* gen, int64_t value) {
+    if (object_fits_small_int(value)) {
+        return operand("object_small_int(INT64_C(%" PRId64 "))", value);
+    }
+
+    // wide constants are boxed once, marked so the collector leaves them alone.
+    int index = gen->statics_size++;
+
+    // the smallest value has no literal, its magnitude does not fit before being negated.
+    if (value == INT64_MIN) {
+        buffer_printf(&gen->statics, "static ObjInt bsl_int_%d = { { NULL, OBJ_INT, true }, INT64_MIN };\n", index);
+    } else {
+        buffer_printf(&gen->statics, "static ObjInt bsl_int_%d = { { NULL, OBJ_INT, true }, INT64_C(%" PRId64 ") };\n", index, value);
+    }
+
+    return operand("object_boxed_int(&bsl_int_%d)", index);
+}
+
+static Operand gen_float(double value) {
+    // folding can produce values that have no literal.
+    if (isnan(value)) {
+        return operand("object_float(NAN)");
+    } else if (isinf(value)) {
+        return operand("object_float(%sINFINITY)", value < 0 ? "-" : "");
+    }
+
+    Operand result = operand("%.17g", value);
+
+    // keeps it a double literal, -0 would be the integer zero.
+    if (!strpbrk(result.text, ".e")) {
+        strcat(result.text, ".0");
+    }
+
+    return operand("object_float(%s)", result.text);
+}
+
+static Operand gen_binary(CGen* gen, BinaryExpression* binary) {
+    int temps = gen->temps;
+
+    Operand lhs = gen_expression(gen, binary->lhs);
+    Operand rhs = gen_expression(gen, binary->rhs);
+
+    gen->temps = temps;
+    int result = push_temp(gen);
+
+    line(gen, "frame[%d] = runtime_binary(%s, %s, %s);", result, binary_name(binary->type), lhs.text, rhs.text);
+
+    return operand("frame[%d]", result);
+}
+
+// evaluates every argument into consecutive slots of the frame, starting at the returned one.
+static int gen_arguments(CGen* gen, Expression** args, int args_size) {
+    int first = gen->temps;
+    for (int i = 0; i < args_size; i++) {
+        (void) push_temp(gen);
+    }
+
+    for (int i = 0; i < args_size; i++) {
+        Operand arg = gen_expression(gen, args[i]);
+        line(gen, "frame[%d] = %s;", gen->fundecl->slots_size + first + i, arg.text);
+
+        gen->temps = first + args_size;
+    }
+
+    return gen->fundecl->slots_size + first;
+}
+
+static void use_record(CGen* gen, Record* record) {
+    gen->records_used[record - gen->module->records] = true;
+}
+
+static FunctionDeclaration* find_callee(CGen* gen, FunctionCall* funcall) {
+    FunctionDeclaration* fun = module_find_fundecl(gen->module, funcall->symbol);
+
+    // errors are raised once the call is reached, like the interpreter does.
+    if (!fun) {
+        line(gen, "error_and_die(\"no such function: "SPAN_FMT"\");", SPAN_ARG(funcall->id));
+        return NULL;
+    }
+
+    if (funcall->args_size != fun->args_size) {
+        line(gen, "error_and_die(\""SPAN_FMT" expected: %d arguments but got: %d\");", SPAN_ARG(fun->id), fun->args_size, funcall->args_size);
+        return NULL;
+    }
+
+    gen->functions_used[fun - gen->module->fundecls] = true;
+
+    return fun;
+}
+
+static Operand gen_print(CGen* gen, FunctionCall* funcall) {
+    if (funcall->args_size != 1) {
+        line(gen, "error_and_die(\"print expected: 1 arguments but got: %d\");", funcall->args_size);
+        return operand("object_void()");
+    }
+
+    int temps = gen->temps;
+    Operand arg = gen_expression(gen, funcall->args[0]);
+    gen->temps = temps;
+
+    line(gen, "runtime_print(%s);", arg.text);
+
+    return operand("object_void()");
+}
+
+static Operand gen_call(CGen* gen, FunctionCall* funcall) {
+    if (funcall->symbol == SYM_PRINT) {
+        return gen_print(gen, funcall);
+    }
+
+    FunctionDeclaration* fun = find_callee(gen, funcall);
+    if (!fun) {
+        return operand("object_void()");
+    }
+
+    int temps = gen->temps;
+
+    // the callee's frame is pushed first and the arguments evaluated straight into it.
+    line(gen, "{");
+    gen->depth++;
+
+    line(gen, "Object* callee = runtime_push_frame(BSL_FRAME_"SPAN_FMT");", SPAN_ARG(fun->id));
+
+    for (int i = 0; i < funcall->args_size; i++) {
+        Operand arg = gen_expression(gen, funcall->args[i]);
+        line(gen, "callee[%d] = %s;", i, arg.text);
+
+        gen->temps = temps;
+    }
+
+    int result = push_temp(gen);
+
+    line(gen, "frame[%d] = runtime_call(bsl_fn_"SPAN_FMT", callee);", result, SPAN_ARG(fun->id));
+    line(gen, "runtime_pop_frame(callee);");
+
+    gen->depth--;
+    line(gen, "}");
+
+    return operand("frame[%d]", result);
+}
+
+// a call in tail position replaces the frame of the caller instead of growing the stack.
+static void gen_tail_call(CGen* gen, FunctionCall* funcall) {
+    FunctionDeclaration* fun = find_callee(gen, funcall);
+    if (!fun) {
+        return;
+    }
+
+    int temps = gen->temps;
+    int first = gen_arguments(gen, funcall->args, funcall->args_size);
+    gen->temps = temps;
+
+    // the temporaries all come after the arguments, copying forwards never clobbers one.
+    for (int i = 0; i < funcall->args_size; i++) {
+        line(gen, "frame[%d] = frame[%d];", i, first + i);
+    }
+
+    if (fun == gen->fundecl) {
+        line(gen, "goto entry;");
+        gen->uses_entry = true;
+        return;
+    }
+
+    line(gen, "runtime_resize_frame(frame, %d, BSL_FRAME_"SPAN_FMT");", fun->args_size, SPAN_ARG(fun->id));
+    line(gen, "runtime.tail = bsl_fn_"SPAN_FMT";", SPAN_ARG(fun->id));
+    line(gen, "return object_void();");
+}
+
+static Operand gen_record_creation(CGen* gen, RecordCreation* record_creation) {
+    Record* record = module_find_record(gen->module, record_creation->symbol);
+    if (!record) {
+        line(gen, "error_and_die(\"no such record: "SPAN_FMT"\");", SPAN_ARG(record_creation->id));
+        return operand("object_void()");
+    }
+
+    if (record_creation->args_size != record->fields_size) {
+        line(gen, "error_and_die(\""SPAN_FMT" expected: %d arguments but got: %d\");",
+             SPAN_ARG(record_creation->id), record->fields_size, record_creation->args_size);
+        return operand("object_void()");
+    }
+
+    use_record(gen, record);
+
+    int temps = gen->temps;
+    int first = gen_arguments(gen, record_creation->args, record_creation->args_size);
+    gen->temps = temps;
+
+    int result = push_temp(gen);
+
+    line(gen, "frame[%d] = runtime_record(&bsl_record_"SPAN_FMT", &frame[%d]);", result, SPAN_ARG(record->id), first);
+
+    return operand("frame[%d]", result);
+}
+
+static Operand gen_field_access(CGen* gen, FieldAccess* field_access) {
+    int temps = gen->temps;
+    Operand object = gen_expression(gen, field_access->expr);
+    gen->temps = temps;
+
+    int index = gen->statics_size++;
+
+    buffer_printf(&gen->statics, "static FieldAccess bsl_field_%d = { .field = { \""SPAN_FMT"\", %d }, .symbol = %d",
+                  index, SPAN_ARG(field_access->field), field_access->field.size, field_access->symbol);
+
+    // carries over what the resolver already knows about the field.
+    if (field_access->cached_shape) {
+        use_record(gen, field_access->cached_shape);
+        buffer_printf(&gen->statics, ", .cached_shape = &bsl_record_"SPAN_FMT", .cached_offset = %d",
+                      SPAN_ARG(field_access->cached_shape->id), field_access->cached_offset);
+    }
+
+    buffer_printf(&gen->statics, " };\n");
+
+    int result = push_temp(gen);
+
+    line(gen, "frame[%d] = runtime_field(&bsl_field_%d, %s);", result, index, object.text);
+
+    return operand("frame[%d]", result);
+}
+
+static Operand gen_expression(CGen* gen, Expression* expression) {
+    if (expression->type == EXPR_BINARY) {
+        return gen_binary(gen, &expression->as.binary);
+    }
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_INT:
+            return gen_int(gen, value->as.integer);
+        case VAL_FLOAT:
+            return gen_float(value->as.floating);
+        case VAL_IDENT:
+            return operand("frame[%d]", value->as.identifier.slot);
+        case VAL_FUNCALL:
+            return gen_call(gen, &value->as.funcall);
+        case VAL_RECORD_CREATION:
+            return gen_record_creation(gen, &value->as.record_creation);
+        case VAL_FIELD_ACCESS:
+            return gen_field_access(gen, &value->as.field_access);
+    }
+
+    error_and_die("unreachable");
+}
+
+static void gen_let_block(CGen* gen, LetBlock* letblock) {
+    for (int i = 0; i < letblock->ids_size; i++) {
+        line(gen, "frame[%d] = object_small_int(0);", letblock->ids[i].slot);
+    }
+
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        Assignment* assignment = &letblock->assignments[i];
+
+        int temps = gen->temps;
+        Operand value = gen_expression(gen, assignment->expr);
+        gen->temps = temps;
+
+        line(gen, "frame[%d] = %s;", assignment->slot, value.text);
+    }
+}
+
+static void gen_if_statement(CGen* gen, IfStatement* ifstatement, int target) {
+    int temps = gen->temps;
+    Operand condition = gen_expression(gen, ifstatement->expr);
+    gen->temps = temps;
+
+    line(gen, "if (runtime_truthy(%s)) {", condition.text);
+    gen->depth++;
+    gen_block(gen, ifstatement->true_block, target);
+    gen->depth--;
+    line(gen, "} else {");
+    gen->depth++;
+    gen_block(gen, ifstatement->false_block, target);
+    gen->depth--;
+    line(gen, "}");
+}
+
+static bool is_call(Expression* expression) {
+    return expression->type == EXPR_PRIMARY && expression->as.primary.type == VAL_FUNCALL &&
+           expression->as.primary.as.funcall.symbol != SYM_PRINT;
+}
+
+// the value of the block ends up in slot target of the frame, or is returned.
+static void gen_block(CGen* gen, Block* block, int target) {
+    if (block->children_size < 1) {
+        line(gen, "error_and_die(\"expected expressions\");");
+        return;
+    }
+
+    for (int i = 0; i < block->children_size - 1; i++) {
+        Statement* statement = &block->children[i];
+        int temps = gen->temps;
+
+        switch (statement->type) {
+            case STMT_LETBLOCK:
+                gen_let_block(gen, &statement->as.letblock);
+                break;
+            case STMT_IF:
+                gen_if_statement(gen, &statement->as.ifstatement, push_temp(gen));
+                break;
+            case STMT_EXPRESSION:
+                (void) gen_expression(gen, statement->as.expression);
+                break;
+        }
+
+        gen->temps = temps;
+    }
+
+    Statement* last = &block->children[block->children_size - 1];
+
+    if (last->type == STMT_EXPRESSION) {
+        if (target == TARGET_RETURN && is_call(last->as.expression)) {
+            gen_tail_call(gen, &last->as.expression->as.primary.as.funcall);
+            return;
+        }
+
+        int temps = gen->temps;
+        Operand value = gen_expression(gen, last->as.expression);
+        gen->temps = temps;
+
+        if (target == TARGET_RETURN) {
+            line(gen, "return %s;", value.text);
+        } else {
+            line(gen, "frame[%d] = %s;", target, value.text);
+        }
+    } else if (last->type == STMT_IF) {
+        gen_if_statement(gen, &last->as.ifstatement, target);
+    } else {
+        line(gen, "error_and_die(\"any block is expected to return something\");");
+    }
+}
+
+// returns the frame size of the function, its slots and every temporary.
+static int gen_function(CGen* gen, FunctionDeclaration* fundecl) {
+    gen->fundecl = fundecl;
+    gen->temps = 0;
+    gen->temps_max = 0;
+    gen->uses_entry = false;
+
+    Buffer header = gen->code;
+    gen->code = (Buffer) {0};
+
+    gen->depth = 1;
+    gen_block(gen, fundecl->block, TARGET_RETURN);
+
+    Buffer body = gen->code;
+    gen->code = header;
+
+    buffer_printf(&gen->code, "\nstatic Object bsl_fn_"SPAN_FMT"(Object* frame) {\n", SPAN_ARG(fundecl->id));
+    if (gen->uses_entry) {
+        buffer_printf(&gen->code, "entry:\n");
+    }
+    if (body.size > 0) {
+        buffer_printf(&gen->code, "%s", body.data);
+    }
+    if (body.size == 0 || !strstr(body.data, "frame[")) {
+        buffer_printf(&gen->code, "    (void) frame;\n");
+    }
+    buffer_printf(&gen->code, "}\n");
+
+    buffer_free(&body);
+
+    return fundecl->slots_size + gen->temps_max;
+}
+
+static void gen_record(FILE* out, Record* record) {
+    fprintf(out, "static Identifier bsl_fields_"SPAN_FMT"[] = {\n", SPAN_ARG(record->id));
+    for (int i = 0; i < record->fields_size; i++) {
+        Identifier* field = &record->fields[i];
+        fprintf(out, "    { .id = { \""SPAN_FMT"\", %d }, .symbol = %d, .slot = %d },\n",
+                SPAN_ARG(field->id), field->id.size, field->symbol, field->slot);
+    }
+    // keeps the array non empty for records without fields.
+    fprintf(out, "    { .symbol = SYMBOL_NONE },\n");
+    fprintf(out, "};\n");
+
+    fprintf(out, "static Record bsl_record_"SPAN_FMT" = { .id = { \""SPAN_FMT"\", %d }, .symbol = %d, .fields = bsl_fields_"SPAN_FMT", .fields_size = %d, .fields_cap = %d };\n",
+            SPAN_ARG(record->id), SPAN_ARG(record->id), record->id.size, record->symbol, SPAN_ARG(record->id), record->fields_size, record->fields_size);
+}
+
+void cgen_module(Module* module, FILE* out) {
+    assert(module != NULL);
+    assert(out != NULL);
+
+    FunctionDeclaration* entry_point = module_find_fundecl(module, SYM_MAIN);
+    if (!entry_point) {
+        error_and_die("no entry main point function");
+    }
+
+    CGen gen = {
+        .module = module,
+    };
+
+    int* frame_sizes = malloc(sizeof(int) * (module->fundecls_size + 1));
+    gen.functions_used = calloc(module->fundecls_size + 1, sizeof(bool));
+    gen.records_used = calloc(module->records_size + 1, sizeof(bool));
+    if (!frame_sizes || !gen.functions_used || !gen.records_used) {
+        error_and_die("cannot allocate memory");
+    }
+
+    // generating a function marks its callees, until no new one shows up.
+    gen.functions_used[entry_point - module->fundecls] = true;
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        frame_sizes[i] = -1;
+    }
+
+    bool generated = true;
+    while (generated) {
+        generated = false;
+
+        for (int i = 0; i < module->fundecls_size; i++) {
+            if (gen.functions_used[i] && frame_sizes[i] < 0) {
+                frame_sizes[i] = gen_function(&gen, &module->fundecls[i]);
+                generated = true;
+            }
+        }
+    }
+
+    fprintf(out, "// generated by basilisk --emit-c, build it against runtime.h and libbasilisk_runtime.\n");
+    fprintf(out, "#include <math.h>\n\n");
+    fprintf(out, "#include \"runtime.h\"\n\n");
+
+    for (int i = 0; i < module->records_size; i++) {
+        if (gen.records_used[i]) {
+            gen_record(out, &module->records[i]);
+        }
+    }
+
+    if (gen.statics.size > 0) {
+        fprintf(out, "%s", gen.statics.data);
+    }
+
+    fprintf(out, "\n");
+    for (int i = 0; i < module->fundecls_size; i++) {
+        FunctionDeclaration* fundecl = &module->fundecls[i];
+        if (!gen.functions_used[i])
+            continue;
+
+        fprintf(out, "#define BSL_FRAME_"SPAN_FMT" %d\n", SPAN_ARG(fundecl->id), frame_sizes[i]);
+        fprintf(out, "static Object bsl_fn_"SPAN_FMT"(Object* frame);\n", SPAN_ARG(fundecl->id));
+    }
+
+    if (gen.code.size > 0) {
+        fprintf(out, "%s", gen.code.data);
+    }
+
+    fprintf(out, "\nint main(void) {\n");
+    fprintf(out, "    runtime_init();\n");
+    fprintf(out, "    return runtime_exit(runtime_run(bsl_fn_main, BSL_FRAME_main));\n");
+    fprintf(out, "}\n");
+
+    free(frame_sizes);
+    free(gen.functions_used);
+    free(gen.records_used);
+    buffer_free(&gen.statics);
+    buffer_free(&gen.code);
+}
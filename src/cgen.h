@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "ast.h"
+
+// writes the resolved module out as a standalone C translation unit. it only
+// needs runtime.h and libbasilisk_runtime to build, none of the front end.
+void cgen_module(Module* module, FILE* out);
@@ -0,0 +1,569 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "closure.h"
+#include "common.h"
+
+#define SLOT(base, slot) (engine->frames[(base) + (slot)])
+#define RUN(closure, base) ((closure)->run(engine, (closure), (base)))
+
+static int push_frame(ClosureEngine* engine, int slots_size) {
+    int base = engine->frames_size;
+    int size = base + slots_size;
+
+    if (size > engine->frames_cap) {
+        while (engine->frames_cap < size) {
+            engine->frames_cap = engine->frames_cap ? engine->frames_cap * 2 : 1024;
+        }
+
+        engine->frames = realloc(engine->frames, sizeof(Object) * engine->frames_cap);
+        if (!engine->frames) {
+            error_and_die("cannot allocate memory");
+        }
+
+        engine->stats.allocations++;
+    }
+
+    // unassigned slots read as integer zero, just like a fresh let binding.
+    for (int i = base; i < size; i++) {
+        engine->frames[i] = object_small_int(0);
+    }
+
+    engine->frames_size = size;
+
+    if (size > engine->stats.frames_peak) {
+        engine->stats.frames_peak = size;
+    }
+
+    return base;
+}
+
+static Object call_function(ClosureEngine* engine, ClosureFunction* function, int base) {
+    // calls in tail position reuse the current frame instead of growing the C stack.
+    for (;;) {
+        Object result = RUN(function->body, base);
+        if (!engine->tail_callee) {
+            return result;
+        }
+
+        function = engine->tail_callee;
+        engine->tail_callee = NULL;
+
+        // the callee's frame sits right on top of ours, slide its arguments down.
+        int args_size = function->fundecl->args_size;
+        memmove(&SLOT(base, 0), &SLOT(engine->tail_base, 0), sizeof(Object) * args_size);
+
+        engine->frames_size = base + args_size;
+        (void) push_frame(engine, function->fundecl->slots_size - args_size);
+    }
+}
+
+static Object run_constant(ClosureEngine* engine, Closure* closure, int base) {
+    (void) engine;
+    (void) base;
+
+    return closure->constant;
+}
+
+static Object run_load(ClosureEngine* engine, Closure* closure, int base) {
+    return SLOT(base, closure->slot);
+}
+
+// the slow path of every binary closure once lhs is a heap object, which has to
+// stay reachable from the frame stack while rhs runs.
+static Object run_binary_rooted(ClosureEngine* engine, Closure* closure, int base, BinaryExpressionType type, Object lhs) {
+    int temp = push_frame(engine, 1);
+    SLOT(temp, 0) = lhs;
+
+    Object rhs = RUN(closure->rhs, base);
+
+    engine->frames_size = temp;
+
+    return perform_binary(&engine->heap, type, lhs, rhs);
+}
+
+#define ARITHMETIC_CLOSURE(name, type, op) \
+    static Object name(ClosureEngine* engine, Closure* closure, int base) {\
+        Object lhs = RUN(closure->lhs, base);\
+        if (object_is_heap(lhs)) {\
+            return run_binary_rooted(engine, closure, base, type, lhs);\
+        }\
+        Object rhs = RUN(closure->rhs, base);\
+        if (object_is_small_int(lhs) && object_is_small_int(rhs)) {\
+            return heap_make_int(&engine->heap, object_as_small_int(lhs) op object_as_small_int(rhs));\
+        }\
+        if (object_is_float(lhs) && object_is_float(rhs)) {\
+            return object_float(object_as_float(lhs) op object_as_float(rhs));\
+        }\
+        return perform_binary(&engine->heap, type, lhs, rhs);\
+    }\
+
+#define COMPARISON_CLOSURE(name, type, op) \
+    static Object name(ClosureEngine* engine, Closure* closure, int base) {\
+        Object lhs = RUN(closure->lhs, base);\
+        if (object_is_heap(lhs)) {\
+            return run_binary_rooted(engine, closure, base, type, lhs);\
+        }\
+        Object rhs = RUN(closure->rhs, base);\
+        if (object_is_small_int(lhs) && object_is_small_int(rhs)) {\
+            return object_small_int(object_as_small_int(lhs) op object_as_small_int(rhs));\
+        }\
+        if (object_is_float(lhs) && object_is_float(rhs)) {\
+            return object_small_int(object_as_float(lhs) op object_as_float(rhs));\
+        }\
+        return perform_binary(&engine->heap, type, lhs, rhs);\
+    }\
+
+ARITHMETIC_CLOSURE(run_add, BIN_ADD, +)
+ARITHMETIC_CLOSURE(run_sub, BIN_SUB, -)
+ARITHMETIC_CLOSURE(run_mul, BIN_MUL, *)
+ARITHMETIC_CLOSURE(run_div, BIN_DIV, /)
+COMPARISON_CLOSURE(run_equ, BIN_EQU, ==)
+COMPARISON_CLOSURE(run_nequ, BIN_NEQU, !=)
+COMPARISON_CLOSURE(run_gt, BIN_GT, >)
+COMPARISON_CLOSURE(run_lt, BIN_LT, <)
+COMPARISON_CLOSURE(run_gteq, BIN_GTEQ, >=)
+COMPARISON_CLOSURE(run_lteq, BIN_LTEQ, <=)
+COMPARISON_CLOSURE(run_and, BIN_AND, &&)
+COMPARISON_CLOSURE(run_or, BIN_OR, ||)
+
+static Object run_call(ClosureEngine* engine, Closure* closure, int base) {
+    ClosureFunction* callee = closure->callee;
+    int frame = push_frame(engine, callee->fundecl->slots_size);
+
+    for (int i = 0; i < closure->children_size; i++) {
+        // running the argument may grow the frame stack, so store it afterwards.
+        Object object = RUN(closure->children[i], base);
+        SLOT(frame, i) = object;
+    }
+
+    engine->stats.calls++;
+
+    Object result = call_function(engine, callee, frame);
+    engine->frames_size = frame;
+
+    return result;
+}
+
+// pushes the callee's frame and hands it back to call_function instead of entering it.
+static Object run_tail_call(ClosureEngine* engine, Closure* closure, int base) {
+    ClosureFunction* callee = closure->callee;
+    int frame = push_frame(engine, callee->fundecl->slots_size);
+
+    for (int i = 0; i < closure->children_size; i++) {
+        Object object = RUN(closure->children[i], base);
+        SLOT(frame, i) = object;
+    }
+
+    engine->stats.calls++;
+
+    engine->tail_callee = callee;
+    engine->tail_base = frame;
+
+    return object_void();
+}
+
+// calls that cannot be bound, they fail when reached just like in the tree walker.
+static Object run_bad_call(ClosureEngine* engine, Closure* closure, int base) {
+    (void) base;
+
+    FunctionCall* funcall = &closure->value->as.funcall;
+
+    if (funcall->symbol == SYM_PRINT) {
+        error_and_die("print expected: %d arguments but got: %d", 1, funcall->args_size);
+    }
+
+    FunctionDeclaration* fun = module_find_fundecl(engine->module, funcall->symbol);
+    if (!fun) {
+        error_and_die("no such function: "SPAN_FMT, SPAN_ARG(funcall->id));
+    }
+
+    error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(fun->id), fun->args_size, funcall->args_size);
+}
+
+static Object run_print(ClosureEngine* engine, Closure* closure, int base) {
+    Object object = RUN(closure->lhs, base);
+
+    int frame = push_frame(engine, 1);
+    SLOT(frame, 0) = object;
+
+    object_print(&SLOT(frame, 0));
+    printf("\n");
+
+    engine->frames_size = frame;
+
+    return object_void();
+}
+
+static Object run_record(ClosureEngine* engine, Closure* closure, int base) {
+    // the fields are kept on the frame stack until the record exists.
+    int fields = push_frame(engine, closure->children_size);
+
+    for (int i = 0; i < closure->children_size; i++) {
+        Object object = RUN(closure->children[i], base);
+        SLOT(fields, i) = object;
+    }
+
+    ObjRecord* objrecord = heap_alloc_record(&engine->heap, closure->record);
+    memcpy(objrecord->fields, &SLOT(fields, 0), sizeof(Object) * closure->children_size);
+
+    engine->frames_size = fields;
+    engine->stats.allocations++;
+
+    return object_record(objrecord);
+}
+
+static Object run_bad_record(ClosureEngine* engine, Closure* closure, int base) {
+    (void) base;
+
+    RecordCreation* record_creation = &closure->value->as.record_creation;
+
+    Record* record = module_find_record(engine->module, record_creation->symbol);
+    if (!record) {
+        error_and_die("no such record: "SPAN_FMT, SPAN_ARG(record_creation->id));
+    }
+
+    error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(record_creation->id), record->fields_size, record_creation->args_size);
+}
+
+static Object run_field_access(ClosureEngine* engine, Closure* closure, int base) {
+    FieldAccess* field_access = &closure->value->as.field_access;
+    Object object = RUN(closure->lhs, base);
+
+    if (object_is_record(object) && object_as_record(object)->shape == field_access->cached_shape) {
+        return object_as_record(object)->fields[field_access->cached_offset];
+    }
+
+    engine->stats.field_cache_misses++;
+
+    return object_as_record(object)->fields[object_field_offset(&object, field_access)];
+}
+
+static Object run_store(ClosureEngine* engine, Closure* closure, int base) {
+    Object object = RUN(closure->lhs, base);
+    SLOT(base, closure->slot) = object;
+
+    return object_void();
+}
+
+static Object run_let(ClosureEngine* engine, Closure* closure, int base) {
+    for (int i = 0; i < closure->slots_size; i++) {
+        SLOT(base, closure->slots[i]) = object_small_int(0);
+    }
+
+    for (int i = 0; i < closure->children_size; i++) {
+        (void) RUN(closure->children[i], base);
+    }
+
+    return object_void();
+}
+
+static Object run_if(ClosureEngine* engine, Closure* closure, int base) {
+    Object expr = RUN(closure->lhs, base);
+    if (!object_is_int(expr)) {
+        error_and_die("if expressions should be boolean");
+    }
+
+    Closure* taken = object_as_int(expr) ? closure->children[0] : closure->children[1];
+
+    return RUN(taken, base);
+}
+
+static Object run_block(ClosureEngine* engine, Closure* closure, int base) {
+    for (int i = 0; i < closure->children_size - 1; i++) {
+        (void) RUN(closure->children[i], base);
+    }
+
+    return RUN(closure->children[closure->children_size - 1], base);
+}
+
+static Object run_missing_value(ClosureEngine* engine, Closure* closure, int base) {
+    (void) engine;
+    (void) closure;
+    (void) base;
+
+    error_and_die("any block is expected to return something");
+}
+
+static Object run_empty_block(ClosureEngine* engine, Closure* closure, int base) {
+    (void) engine;
+    (void) closure;
+    (void) base;
+
+    error_and_die("expected expressions");
+}
+
+static Closure* closure_make(ClosureEngine* engine, ClosureRun run) {
+    Closure* closure = arena_alloc(&engine->arena, sizeof(Closure));
+    memset(closure, 0, sizeof(Closure));
+
+    closure->run = run;
+    closure->slot = -1;
+
+    return closure;
+}
+
+static Closure** closure_children(ClosureEngine* engine, int size) {
+    return arena_alloc(&engine->arena, sizeof(Closure*) * (size ? size : 1));
+}
+
+static Closure* compile_expression(ClosureEngine* engine, Expression* expression, bool tail);
+
+static Closure* compile_arguments(ClosureEngine* engine, Closure* closure, Expression** args, int args_size) {
+    closure->children = closure_children(engine, args_size);
+    closure->children_size = args_size;
+
+    for (int i = 0; i < args_size; i++) {
+        closure->children[i] = compile_expression(engine, args[i], false);
+    }
+
+    return closure;
+}
+
+static Closure* compile_funcall(ClosureEngine* engine, Value* value, bool tail) {
+    FunctionCall* funcall = &value->as.funcall;
+
+    if (funcall->symbol == SYM_PRINT) {
+        if (funcall->args_size != 1) {
+            Closure* closure = closure_make(engine, run_bad_call);
+            closure->value = value;
+            return closure;
+        }
+
+        Closure* closure = closure_make(engine, run_print);
+        closure->lhs = compile_expression(engine, funcall->args[0], false);
+        return closure;
+    }
+
+    int index = symbol_map_get(&engine->module->fundecls_index, funcall->symbol);
+    if (index < 0 || engine->module->fundecls[index].args_size != funcall->args_size) {
+        Closure* closure = closure_make(engine, run_bad_call);
+        closure->value = value;
+        return closure;
+    }
+
+    Closure* closure = closure_make(engine, tail ? run_tail_call : run_call);
+    closure->callee = &engine->functions[index];
+
+    return compile_arguments(engine, closure, funcall->args, funcall->args_size);
+}
+
+static Closure* compile_record_creation(ClosureEngine* engine, Value* value) {
+    RecordCreation* record_creation = &value->as.record_creation;
+
+    int index = symbol_map_get(&engine->module->records_index, record_creation->symbol);
+    if (index < 0 || engine->module->records[index].fields_size != record_creation->args_size) {
+        Closure* closure = closure_make(engine, run_bad_record);
+        closure->value = value;
+        return closure;
+    }
+
+    Closure* closure = closure_make(engine, run_record);
+    closure->record = &engine->module->records[index];
+
+    return compile_arguments(engine, closure, record_creation->args, record_creation->args_size);
+}
+
+static ClosureRun binary_run(BinaryExpressionType type) {
+    switch (type) {
+        case BIN_ADD: return run_add;
+        case BIN_SUB: return run_sub;
+        case BIN_MUL: return run_mul;
+        case BIN_DIV: return run_div;
+        case BIN_EQU: return run_equ;
+        case BIN_NEQU: return run_nequ;
+        case BIN_GT: return run_gt;
+        case BIN_LT: return run_lt;
+        case BIN_GTEQ: return run_gteq;
+        case BIN_LTEQ: return run_lteq;
+        case BIN_AND: return run_and;
+        case BIN_OR: return run_or;
+    }
+
+    error_and_die("unreachable");
+}
+
+static Closure* compile_expression(ClosureEngine* engine, Expression* expression, bool tail) {
+    if (expression->type == EXPR_BINARY) {
+        Closure* closure = closure_make(engine, binary_run(expression->as.binary.type));
+        closure->lhs = compile_expression(engine, expression->as.binary.lhs, false);
+        closure->rhs = compile_expression(engine, expression->as.binary.rhs, false);
+        return closure;
+    }
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_INT: {
+            Closure* closure = closure_make(engine, run_constant);
+            closure->constant = object_static_int(&engine->arena, value->as.integer);
+            return closure;
+        }
+        case VAL_FLOAT: {
+            Closure* closure = closure_make(engine, run_constant);
+            closure->constant = object_float(value->as.floating);
+            return closure;
+        }
+        case VAL_IDENT: {
+            Closure* closure = closure_make(engine, run_load);
+            closure->slot = value->as.identifier.slot;
+            return closure;
+        }
+        case VAL_FUNCALL:
+            return compile_funcall(engine, value, tail);
+        case VAL_RECORD_CREATION:
+            return compile_record_creation(engine, value);
+        case VAL_FIELD_ACCESS: {
+            Closure* closure = closure_make(engine, run_field_access);
+            closure->lhs = compile_expression(engine, value->as.field_access.expr, false);
+            closure->value = value;
+            return closure;
+        }
+    }
+
+    error_and_die("unreachable");
+}
+
+static Closure* compile_let_block(ClosureEngine* engine, LetBlock* letblock) {
+    Closure* closure = closure_make(engine, run_let);
+
+    closure->slots = arena_alloc(&engine->arena, sizeof(int) * letblock->ids_size);
+    closure->slots_size = letblock->ids_size;
+    for (int i = 0; i < letblock->ids_size; i++) {
+        closure->slots[i] = letblock->ids[i].slot;
+    }
+
+    closure->children = closure_children(engine, letblock->assignments_size);
+    closure->children_size = letblock->assignments_size;
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        Closure* store = closure_make(engine, run_store);
+        store->slot = letblock->assignments[i].slot;
+        store->lhs = compile_expression(engine, letblock->assignments[i].expr, false);
+
+        closure->children[i] = store;
+    }
+
+    return closure;
+}
+
+static Closure* compile_block(ClosureEngine* engine, Block* block, bool tail);
+
+static Closure* compile_statement(ClosureEngine* engine, Statement* statement, bool tail) {
+    switch (statement->type) {
+        case STMT_LETBLOCK:
+            return compile_let_block(engine, &statement->as.letblock);
+        case STMT_IF: {
+            Closure* closure = closure_make(engine, run_if);
+            closure->lhs = compile_expression(engine, statement->as.ifstatement.expr, false);
+
+            closure->children = closure_children(engine, 2);
+            closure->children_size = 2;
+            closure->children[0] = compile_block(engine, statement->as.ifstatement.true_block, tail);
+            closure->children[1] = compile_block(engine, statement->as.ifstatement.false_block, tail);
+            return closure;
+        }
+        case STMT_EXPRESSION:
+            return compile_expression(engine, statement->as.expression, tail);
+    }
+
+    error_and_die("unreachable");
+}
+
+// when tail is set, a call in tail position hands its frame back to call_function.
+static Closure* compile_block(ClosureEngine* engine, Block* block, bool tail) {
+    // like a missing value, an empty block only fails once it runs.
+    if (block->children_size < 1) {
+        return closure_make(engine, run_empty_block);
+    }
+
+    Statement* last = &block->children[block->children_size - 1];
+    bool missing_value = last->type == STMT_LETBLOCK;
+
+    Closure* closure = closure_make(engine, run_block);
+    closure->children_size = block->children_size + (missing_value ? 1 : 0);
+    closure->children = closure_children(engine, closure->children_size);
+
+    for (int i = 0; i < block->children_size; i++) {
+        closure->children[i] = compile_statement(engine, &block->children[i], tail && i == block->children_size - 1);
+    }
+
+    if (missing_value) {
+        closure->children[block->children_size] = closure_make(engine, run_missing_value);
+    }
+
+    return closure;
+}
+
+static void mark_closure_roots(Heap* heap, void* context) {
+    ClosureEngine* engine = context;
+
+    heap_mark_objects(heap, engine->frames, engine->frames_size);
+}
+
+void closure_engine_init(ClosureEngine* engine, Module* module) {
+    assert(engine != NULL);
+    assert(module != NULL);
+
+    engine->module = module;
+
+    arena_init(&engine->arena);
+
+    engine->frames = NULL;
+    engine->frames_size = 0;
+    engine->frames_cap = 0;
+
+    engine->tail_callee = NULL;
+    engine->tail_base = 0;
+
+    heap_init(&engine->heap, mark_closure_roots, engine);
+
+    engine->stats = (InterpreterStats) {0};
+
+    // every function gets its slot first, so calls can bind to their callee before it is compiled.
+    engine->functions = arena_alloc(&engine->arena, sizeof(ClosureFunction) * (module->fundecls_size ? module->fundecls_size : 1));
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        engine->functions[i] = (ClosureFunction) {
+            .fundecl = &module->fundecls[i],
+            .body = NULL,
+        };
+    }
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        engine->functions[i].body = compile_block(engine, module->fundecls[i].block, true);
+    }
+}
+
+void closure_engine_deinit(ClosureEngine* engine) {
+    assert(engine != NULL);
+
+    if (engine->frames) {
+        free(engine->frames);
+    }
+
+    heap_deinit(&engine->heap);
+    arena_free(&engine->arena);
+}
+
+Object closure_engine_run(ClosureEngine* engine) {
+    int index = symbol_map_get(&engine->module->fundecls_index, SYM_MAIN);
+    if (index < 0) {
+        error_and_die("no entry main point function");
+    }
+
+    ClosureFunction* entry_point = &engine->functions[index];
+
+    int base = push_frame(engine, entry_point->fundecl->slots_size);
+    engine->stats.calls++;
+
+    Object return_value = call_function(engine, entry_point, base);
+    engine->frames_size = base;
+
+    if (!object_is_int(return_value)) {
+        error_and_die("main function should return integer");
+    }
+
+    return return_value;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "arena.h"
+#include "ast.h"
+#include "gc.h"
+#include "interpreter.h"
+#include "object.h"
+
+typedef struct ClosureEngine_t ClosureEngine;
+typedef struct Closure_t Closure;
+typedef struct ClosureFunction_t ClosureFunction;
+
+// runs a node against the frame starting at base.
+typedef Object (*ClosureRun)(ClosureEngine* engine, Closure* closure, int base);
+
+// one AST node turned into a C function with its operands bound up front,
+// so running it never switches on the node type or looks a name up again.
+struct Closure_t {
+    ClosureRun run;
+
+    Closure* lhs;
+    Closure* rhs;
+
+    Closure** children; // block statements, call or record arguments, let assignments
+    int children_size;
+
+    int* slots; // let bindings reset on entry to a let block
+    int slots_size;
+
+    int slot;
+    Object constant;
+
+    ClosureFunction* callee;
+    Record* record;
+    Value* value; // the node itself, for field caches and runtime errors
+};
+
+struct ClosureFunction_t {
+    FunctionDeclaration* fundecl;
+    Closure* body;
+};
+
+struct ClosureEngine_t {
+    Module* module;
+
+    // every closure lives as long as the engine.
+    Arena arena;
+
+    ClosureFunction* functions; // parallel to module->fundecls
+
+    // slots of every live frame, bump allocated and reused across calls.
+    Object* frames;
+    int frames_size;
+    int frames_cap;
+
+    // set by a call in tail position, whose frame is pushed but not entered yet.
+    ClosureFunction* tail_callee;
+    int tail_base;
+
+    // records are collected, the frame stack is the root set.
+    Heap heap;
+
+    InterpreterStats stats;
+};
+
+// converts every function of the resolved module into closures.
+void closure_engine_init(ClosureEngine* engine, Module* module);
+void closure_engine_deinit(ClosureEngine* engine);
+
+Object closure_engine_run(ClosureEngine* engine);
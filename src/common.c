@@ -4,11 +4,21 @@
 
 #include "common.h"
 
-NORETURN void error_and_die(const char* fmt, ...) {
-    fprintf(stderr, "ERROR: ");
+_Thread_local ErrorHandler* error_handler = NULL;
 
+NORETURN void error_and_die(const char* fmt, ...) {
     va_list args;
 
+    if (error_handler) {
+        va_start(args, fmt);
+        vsnprintf(error_handler->message, sizeof(error_handler->message), fmt, args);
+        va_end(args);
+
+        longjmp(error_handler->jump, 1);
+    }
+
+    fprintf(stderr, "ERROR: ");
+
     va_start(args, fmt);
     vfprintf(stderr, fmt, args);
     va_end(args);
@@ -1,7 +1,21 @@
 #pragma once
 
+#include <setjmp.h>
 #include <stdnoreturn.h>
 
 #define NORETURN _Noreturn
 
+// catches the errors raised on one thread, error_and_die unwinds to the innermost
+// handler with the message instead of exiting. whatever the failed code was
+// building is left behind.
+typedef struct ErrorHandler_t ErrorHandler;
+
+struct ErrorHandler_t {
+    jmp_buf jump;
+    ErrorHandler* previous;
+    char message[256];
+};
+
+extern _Thread_local ErrorHandler* error_handler;
+
 NORETURN void error_and_die(const char* fmt, ...);
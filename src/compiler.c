@@ -0,0 +1,334 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "compiler.h"
+
+typedef struct {
+    Module* module;
+    BytecodeFunction* function;
+
+    int stack_depth;
+} Compiler;
+
+static void compiler_push(Compiler* compiler, int count) {
+    compiler->stack_depth += count;
+
+    if (compiler->stack_depth > compiler->function->stack_size) {
+        compiler->function->stack_size = compiler->stack_depth;
+    }
+}
+
+static void compiler_pop(Compiler* compiler, int count) {
+    compiler->stack_depth -= count;
+    assert(compiler->stack_depth >= 0);
+}
+
+static void emit(Compiler* compiler, OpCode op) {
+    bytecode_function_emit(compiler->function, op);
+}
+
+static void emit_with_u16(Compiler* compiler, OpCode op, int operand) {
+    if (operand > UINT16_MAX) {
+        error_and_die(SPAN_FMT": operand out of range: %d", SPAN_ARG(compiler->function->id), operand);
+    }
+
+    bytecode_function_emit(compiler->function, op);
+    bytecode_function_emit_u16(compiler->function, operand);
+}
+
+// the error is only raised once the code is reached, so functions that are never
+// called behave as in the tree walker. stands in for a value on the stack.
+static void emit_error(Compiler* compiler, const char* fmt, ...) {
+    char message[512];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    emit_with_u16(compiler, OP_ERROR, bytecode_function_add_error(compiler->function, message));
+    compiler_push(compiler, 1);
+}
+
+static int emit_jump(Compiler* compiler, OpCode op) {
+    emit_with_u16(compiler, op, 0);
+    return compiler->function->code_size;
+}
+
+static void patch_jump(Compiler* compiler, int from) {
+    int offset = compiler->function->code_size - from;
+    if (offset > UINT16_MAX) {
+        error_and_die(SPAN_FMT": jump too large", SPAN_ARG(compiler->function->id));
+    }
+
+    compiler->function->code[from - 2] = offset & 0xff;
+    compiler->function->code[from - 1] = (offset >> 8) & 0xff;
+}
+
+static void compile_block(Compiler* compiler, Block* block, bool tail);
+static void compile_expression(Compiler* compiler, Expression* expression);
+
+static void compile_funcall(Compiler* compiler, FunctionCall* funcall, bool tail) {
+    if (funcall->symbol == SYM_PRINT) {
+        if (funcall->args_size != 1) {
+            emit_error(compiler, "print expected: %d arguments but got: %d", 1, funcall->args_size);
+            return;
+        }
+
+        compile_expression(compiler, funcall->args[0]);
+        emit(compiler, OP_PRINT);
+        return;
+    }
+
+    int index = symbol_map_get(&compiler->module->fundecls_index, funcall->symbol);
+    if (index < 0) {
+        emit_error(compiler, "no such function: "SPAN_FMT, SPAN_ARG(funcall->id));
+        return;
+    }
+
+    FunctionDeclaration* fun = &compiler->module->fundecls[index];
+    if (funcall->args_size != fun->args_size) {
+        emit_error(compiler, SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(fun->id), fun->args_size, funcall->args_size);
+        return;
+    }
+
+    for (int i = 0; i < funcall->args_size; i++) {
+        compile_expression(compiler, funcall->args[i]);
+    }
+
+    emit_with_u16(compiler, tail ? OP_TAIL_CALL : OP_CALL, index);
+    compiler_pop(compiler, funcall->args_size);
+    compiler_push(compiler, 1);
+}
+
+static void compile_record_creation(Compiler* compiler, RecordCreation* record_creation) {
+    int index = symbol_map_get(&compiler->module->records_index, record_creation->symbol);
+    if (index < 0) {
+        emit_error(compiler, "no such record: "SPAN_FMT, SPAN_ARG(record_creation->id));
+        return;
+    }
+
+    Record* record = &compiler->module->records[index];
+    if (record_creation->args_size != record->fields_size) {
+        emit_error(compiler, SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(record_creation->id), record->fields_size, record_creation->args_size);
+        return;
+    }
+
+    for (int i = 0; i < record_creation->args_size; i++) {
+        compile_expression(compiler, record_creation->args[i]);
+    }
+
+    emit_with_u16(compiler, OP_RECORD, index);
+    compiler_pop(compiler, record_creation->args_size);
+    compiler_push(compiler, 1);
+}
+
+static void compile_primary(Compiler* compiler, Value* value) {
+    switch (value->type) {
+        case VAL_INT: {
+            int index = bytecode_function_add_constant(compiler->function, object_static_int(compiler->module->arena, value->as.integer));
+
+            emit_with_u16(compiler, OP_CONST, index);
+            compiler_push(compiler, 1);
+            break;
+        }
+        case VAL_FLOAT: {
+            int index = bytecode_function_add_constant(compiler->function, object_float(value->as.floating));
+
+            emit_with_u16(compiler, OP_CONST, index);
+            compiler_push(compiler, 1);
+            break;
+        }
+        case VAL_IDENT:
+            emit_with_u16(compiler, OP_LOAD, value->as.identifier.slot);
+            compiler_push(compiler, 1);
+            break;
+        case VAL_FUNCALL:
+            compile_funcall(compiler, &value->as.funcall, false);
+            break;
+        case VAL_RECORD_CREATION:
+            compile_record_creation(compiler, &value->as.record_creation);
+            break;
+        case VAL_FIELD_ACCESS:
+            compile_expression(compiler, value->as.field_access.expr);
+            emit_with_u16(compiler, OP_GET_FIELD, bytecode_function_add_field_access(compiler->function, &value->as.field_access));
+            break;
+    }
+}
+
+static void compile_binary(Compiler* compiler, BinaryExpression* binary) {
+    compile_expression(compiler, binary->lhs);
+    compile_expression(compiler, binary->rhs);
+
+    switch (binary->type) {
+        case BIN_ADD:
+            emit(compiler, OP_ADD);
+            break;
+        case BIN_SUB:
+            emit(compiler, OP_SUB);
+            break;
+        case BIN_MUL:
+            emit(compiler, OP_MUL);
+            break;
+        case BIN_DIV:
+            emit(compiler, OP_DIV);
+            break;
+        case BIN_EQU:
+            emit(compiler, OP_EQU);
+            break;
+        case BIN_NEQU:
+            emit(compiler, OP_NEQU);
+            break;
+        case BIN_GT:
+            emit(compiler, OP_GT);
+            break;
+        case BIN_LT:
+            emit(compiler, OP_LT);
+            break;
+        case BIN_GTEQ:
+            emit(compiler, OP_GTEQ);
+            break;
+        case BIN_LTEQ:
+            emit(compiler, OP_LTEQ);
+            break;
+        case BIN_AND:
+            emit(compiler, OP_AND);
+            break;
+        case BIN_OR:
+            emit(compiler, OP_OR);
+            break;
+    }
+
+    compiler_pop(compiler, 1);
+}
+
+static void compile_expression(Compiler* compiler, Expression* expression) {
+    switch (expression->type) {
+        case EXPR_PRIMARY:
+            compile_primary(compiler, &expression->as.primary);
+            break;
+        case EXPR_BINARY:
+            compile_binary(compiler, &expression->as.binary);
+            break;
+    }
+}
+
+static void compile_let_block(Compiler* compiler, LetBlock* letblock) {
+    for (int i = 0; i < letblock->ids_size; i++) {
+        emit_with_u16(compiler, OP_RESET, letblock->ids[i].slot);
+    }
+
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        Assignment* assignment = &letblock->assignments[i];
+
+        compile_expression(compiler, assignment->expr);
+        emit_with_u16(compiler, OP_STORE, assignment->slot);
+        compiler_pop(compiler, 1);
+    }
+}
+
+static void compile_if_statement(Compiler* compiler, IfStatement* ifstatement, bool tail) {
+    compile_expression(compiler, ifstatement->expr);
+
+    int to_false = emit_jump(compiler, OP_JUMP_IF_FALSE);
+    compiler_pop(compiler, 1);
+
+    compile_block(compiler, ifstatement->true_block, tail);
+    compiler_pop(compiler, 1);
+
+    int to_end = emit_jump(compiler, OP_JUMP);
+
+    patch_jump(compiler, to_false);
+    compile_block(compiler, ifstatement->false_block, tail);
+
+    patch_jump(compiler, to_end);
+}
+
+// calls in tail position of a function body become OP_TAIL_CALL.
+static void compile_block(Compiler* compiler, Block* block, bool tail) {
+    if (block->children_size < 1) {
+        emit_error(compiler, "expected expressions");
+        return;
+    }
+
+    for (int i = 0; i < block->children_size - 1; i++) {
+        Statement* statement = &block->children[i];
+
+        switch (statement->type) {
+            case STMT_LETBLOCK:
+                compile_let_block(compiler, &statement->as.letblock);
+                break;
+            case STMT_IF:
+                compile_if_statement(compiler, &statement->as.ifstatement, false);
+                emit(compiler, OP_POP);
+                compiler_pop(compiler, 1);
+                break;
+            case STMT_EXPRESSION:
+                compile_expression(compiler, statement->as.expression);
+                emit(compiler, OP_POP);
+                compiler_pop(compiler, 1);
+                break;
+        }
+    }
+
+    Statement* last = &block->children[block->children_size - 1];
+
+    if (last->type == STMT_EXPRESSION) {
+        Expression* expression = last->as.expression;
+
+        if (tail && expression->type == EXPR_PRIMARY && expression->as.primary.type == VAL_FUNCALL) {
+            compile_funcall(compiler, &expression->as.primary.as.funcall, true);
+        } else {
+            compile_expression(compiler, expression);
+        }
+    } else if (last->type == STMT_IF) {
+        compile_if_statement(compiler, &last->as.ifstatement, tail);
+    } else {
+        emit_error(compiler, "any block is expected to return something");
+    }
+}
+
+static void compile_function_declaration(Compiler* compiler, FunctionDeclaration* fundecl, BytecodeFunction* function) {
+    compiler->function = function;
+    compiler->stack_depth = 0;
+
+    function->id = fundecl->id;
+    function->args_size = fundecl->args_size;
+    function->slots_size = fundecl->slots_size;
+
+    compile_block(compiler, fundecl->block, true);
+    emit(compiler, OP_RETURN);
+}
+
+Program compile_module(Module* module) {
+    assert(module != NULL);
+
+    Program program = {
+        .module = module,
+        .functions = calloc(module->fundecls_size ? module->fundecls_size : 1, sizeof(BytecodeFunction)),
+        .functions_size = module->fundecls_size,
+        .functions_cap = module->fundecls_size,
+        .entry_point = symbol_map_get(&module->fundecls_index, SYM_MAIN),
+    };
+
+    if (!program.functions) {
+        error_and_die("cannot allocate memory");
+    }
+
+    Compiler compiler = {
+        .module = module,
+    };
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        compile_function_declaration(&compiler, &module->fundecls[i], &program.functions[i]);
+    }
+
+    if (program.entry_point < 0) {
+        error_and_die("no entry main point function");
+    }
+
+    return program;
+}
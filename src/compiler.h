@@ -0,0 +1,6 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+
+Program compile_module(Module* module);
@@ -0,0 +1,102 @@
+#include <assert.h>
+
+#include "effects.h"
+
+static bool expression_is_pure(Module* module, Expression* expression);
+
+static bool expressions_are_pure(Module* module, Expression** expressions, int expressions_size) {
+    for (int i = 0; i < expressions_size; i++) {
+        if (!expression_is_pure(module, expressions[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// the callees are taken at their current state, the caller iterates to a fixpoint.
+static bool expression_is_pure(Module* module, Expression* expression) {
+    if (expression->type == EXPR_BINARY) {
+        return expression_is_pure(module, expression->as.binary.lhs)
+            && expression_is_pure(module, expression->as.binary.rhs);
+    }
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_INT:
+        case VAL_FLOAT:
+        case VAL_IDENT:
+            return true;
+        case VAL_FUNCALL: {
+            FunctionCall* funcall = &value->as.funcall;
+            if (funcall->symbol == SYM_PRINT)
+                return false;
+
+            // an unknown function is an error once reached, not an effect.
+            FunctionDeclaration* fun = module_find_fundecl(module, funcall->symbol);
+            if (fun && !fun->pure)
+                return false;
+
+            return expressions_are_pure(module, funcall->args, funcall->args_size);
+        }
+        case VAL_RECORD_CREATION:
+            return expressions_are_pure(module, value->as.record_creation.args, value->as.record_creation.args_size);
+        case VAL_FIELD_ACCESS:
+            return expression_is_pure(module, value->as.field_access.expr);
+    }
+
+    return false;
+}
+
+static bool block_is_pure(Module* module, Block* block) {
+    for (int i = 0; i < block->children_size; i++) {
+        Statement* statement = &block->children[i];
+
+        switch (statement->type) {
+            case STMT_LETBLOCK: {
+                LetBlock* letblock = &statement->as.letblock;
+                for (int j = 0; j < letblock->assignments_size; j++) {
+                    if (!expression_is_pure(module, letblock->assignments[j].expr))
+                        return false;
+                }
+                break;
+            }
+            case STMT_IF:
+                if (!expression_is_pure(module, statement->as.ifstatement.expr)
+                    || !block_is_pure(module, statement->as.ifstatement.true_block)
+                    || !block_is_pure(module, statement->as.ifstatement.false_block))
+                    return false;
+                break;
+            case STMT_EXPRESSION:
+                if (!expression_is_pure(module, statement->as.expression))
+                    return false;
+                break;
+        }
+    }
+
+    return true;
+}
+
+void analyze_effects(Module* module) {
+    assert(module != NULL);
+
+    // everything starts out pure, impurity spreads from print to the callers
+    // until nothing changes. recursion without any print stays pure.
+    for (int i = 0; i < module->fundecls_size; i++) {
+        module->fundecls[i].pure = true;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (int i = 0; i < module->fundecls_size; i++) {
+            FunctionDeclaration* fundecl = &module->fundecls[i];
+
+            if (fundecl->pure && !block_is_pure(module, fundecl->block)) {
+                fundecl->pure = false;
+                changed = true;
+            }
+        }
+    }
+}
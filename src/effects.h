@@ -0,0 +1,8 @@
+#pragma once
+
+#include "ast.h"
+
+// marks every function of the resolved module that can run without printing,
+// whatever it calls. records and errors are not effects, a failing call never
+// returns a value that could be reused.
+void analyze_effects(Module* module);
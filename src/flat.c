@@ -0,0 +1,628 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "flat.h"
+#include "runtime.h"
+
+static int add_node(FlatTree* tree, FlatKind kind, int32_t arg) {
+    if (tree->nodes_size >= tree->nodes_cap) {
+        tree->nodes_cap = tree->nodes_cap ? tree->nodes_cap * 2 : 256;
+        tree->nodes = realloc(tree->nodes, sizeof(FlatNode) * tree->nodes_cap);
+        if (!tree->nodes) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    tree->nodes[tree->nodes_size] = (FlatNode) {
+        .kind = kind,
+        .op = 0,
+        .size = 1,
+        .count = 0,
+        .arg = arg,
+    };
+
+    return tree->nodes_size++;
+}
+
+// called once every child of the node is added.
+static void close_node(FlatTree* tree, int index, uint32_t count) {
+    tree->nodes[index].size = tree->nodes_size - index;
+    tree->nodes[index].count = count;
+}
+
+static int add_constant(FlatTree* tree, FlatConstant constant) {
+    if (tree->constants_size >= tree->constants_cap) {
+        tree->constants_cap = tree->constants_cap ? tree->constants_cap * 2 : 16;
+        tree->constants = realloc(tree->constants, sizeof(FlatConstant) * tree->constants_cap);
+        if (!tree->constants) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    tree->constants[tree->constants_size] = constant;
+
+    return tree->constants_size++;
+}
+
+static int add_field(FlatTree* tree, Module* module, FieldAccess* field_access) {
+    if (tree->fields_size >= tree->fields_cap) {
+        tree->fields_cap = tree->fields_cap ? tree->fields_cap * 2 : 16;
+        tree->fields = realloc(tree->fields, sizeof(FlatField) * tree->fields_cap);
+        if (!tree->fields) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    Record* record = field_access->cached_shape;
+
+    tree->fields[tree->fields_size] = (FlatField) {
+        .symbol = field_access->symbol,
+        .record = record ? record - module->records : -1,
+        .offset = record ? field_access->cached_offset : 0,
+    };
+
+    return tree->fields_size++;
+}
+
+static void lower_expression(FlatTree* tree, Module* module, Expression* expression, bool tail);
+
+static void lower_arguments(FlatTree* tree, Module* module, int index, Expression** args, int args_size) {
+    for (int i = 0; i < args_size; i++) {
+        lower_expression(tree, module, args[i], false);
+    }
+
+    close_node(tree, index, args_size);
+}
+
+static void lower_funcall(FlatTree* tree, Module* module, FunctionCall* funcall, bool tail) {
+    if (funcall->symbol == SYM_PRINT && funcall->args_size == 1) {
+        int index = add_node(tree, FLAT_PRINT, 0);
+        lower_arguments(tree, module, index, funcall->args, 1);
+        return;
+    }
+
+    int callee = funcall->symbol == SYM_PRINT ? -1 : symbol_map_get(&module->fundecls_index, funcall->symbol);
+
+    // calls that cannot be bound fail when reached, just like in the tree walker.
+    if (callee < 0 || module->fundecls[callee].args_size != funcall->args_size) {
+        int index = add_node(tree, FLAT_BAD_CALL, funcall->symbol);
+        close_node(tree, index, funcall->args_size);
+        return;
+    }
+
+    int index = add_node(tree, tail ? FLAT_TAIL_CALL : FLAT_CALL, callee);
+    lower_arguments(tree, module, index, funcall->args, funcall->args_size);
+}
+
+static void lower_record_creation(FlatTree* tree, Module* module, RecordCreation* record_creation) {
+    int record = symbol_map_get(&module->records_index, record_creation->symbol);
+
+    if (record < 0 || module->records[record].fields_size != record_creation->args_size) {
+        int index = add_node(tree, FLAT_BAD_RECORD, record_creation->symbol);
+        close_node(tree, index, record_creation->args_size);
+        return;
+    }
+
+    int index = add_node(tree, FLAT_RECORD, record);
+    lower_arguments(tree, module, index, record_creation->args, record_creation->args_size);
+}
+
+static void lower_expression(FlatTree* tree, Module* module, Expression* expression, bool tail) {
+    if (expression->type == EXPR_BINARY) {
+        int index = add_node(tree, FLAT_BINARY, 0);
+        tree->nodes[index].op = expression->as.binary.type;
+
+        lower_expression(tree, module, expression->as.binary.lhs, false);
+        lower_expression(tree, module, expression->as.binary.rhs, false);
+
+        close_node(tree, index, 2);
+        return;
+    }
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_INT: {
+            int constant = add_constant(tree, (FlatConstant) {.is_float = false, .integer = value->as.integer});
+            add_node(tree, FLAT_CONSTANT, constant);
+            return;
+        }
+        case VAL_FLOAT: {
+            int constant = add_constant(tree, (FlatConstant) {.is_float = true, .floating = value->as.floating});
+            add_node(tree, FLAT_CONSTANT, constant);
+            return;
+        }
+        case VAL_IDENT:
+            add_node(tree, FLAT_LOAD, value->as.identifier.slot);
+            return;
+        case VAL_FUNCALL:
+            lower_funcall(tree, module, &value->as.funcall, tail);
+            return;
+        case VAL_RECORD_CREATION:
+            lower_record_creation(tree, module, &value->as.record_creation);
+            return;
+        case VAL_FIELD_ACCESS: {
+            int index = add_node(tree, FLAT_FIELD, add_field(tree, module, &value->as.field_access));
+            lower_expression(tree, module, value->as.field_access.expr, false);
+            close_node(tree, index, 1);
+            return;
+        }
+    }
+
+    error_and_die("unreachable");
+}
+
+static void lower_let_block(FlatTree* tree, Module* module, LetBlock* letblock) {
+    int index = add_node(tree, FLAT_LET, 0);
+
+    for (int i = 0; i < letblock->ids_size; i++) {
+        add_node(tree, FLAT_RESET, letblock->ids[i].slot);
+    }
+
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        int store = add_node(tree, FLAT_STORE, letblock->assignments[i].slot);
+        lower_expression(tree, module, letblock->assignments[i].expr, false);
+        close_node(tree, store, 1);
+    }
+
+    close_node(tree, index, letblock->ids_size + letblock->assignments_size);
+}
+
+static void lower_block(FlatTree* tree, Module* module, Block* block, bool tail);
+
+static void lower_statement(FlatTree* tree, Module* module, Statement* statement, bool tail) {
+    switch (statement->type) {
+        case STMT_LETBLOCK:
+            lower_let_block(tree, module, &statement->as.letblock);
+            return;
+        case STMT_IF: {
+            int index = add_node(tree, FLAT_IF, 0);
+
+            lower_expression(tree, module, statement->as.ifstatement.expr, false);
+            lower_block(tree, module, statement->as.ifstatement.true_block, tail);
+            lower_block(tree, module, statement->as.ifstatement.false_block, tail);
+
+            close_node(tree, index, 3);
+            return;
+        }
+        case STMT_EXPRESSION:
+            lower_expression(tree, module, statement->as.expression, tail);
+            return;
+    }
+
+    error_and_die("unreachable");
+}
+
+// when tail is set, a call in tail position hands its frame back to call_function.
+static void lower_block(FlatTree* tree, Module* module, Block* block, bool tail) {
+    if (block->children_size < 1) {
+        add_node(tree, FLAT_EMPTY_BLOCK, 0);
+        return;
+    }
+
+    bool missing_value = block->children[block->children_size - 1].type == STMT_LETBLOCK;
+
+    int index = add_node(tree, FLAT_BLOCK, 0);
+
+    for (int i = 0; i < block->children_size; i++) {
+        lower_statement(tree, module, &block->children[i], tail && i == block->children_size - 1);
+    }
+
+    if (missing_value) {
+        add_node(tree, FLAT_MISSING_VALUE, 0);
+    }
+
+    close_node(tree, index, block->children_size + (missing_value ? 1 : 0));
+}
+
+void flat_tree_build(FlatTree* tree, Module* module) {
+    assert(tree != NULL);
+    assert(module != NULL);
+
+    *tree = (FlatTree) {0};
+
+    tree->functions = malloc(sizeof(FlatFunction) * (module->fundecls_size ? module->fundecls_size : 1));
+    if (!tree->functions) {
+        error_and_die("cannot allocate memory");
+    }
+
+    tree->functions_size = module->fundecls_size;
+    tree->entry_point = symbol_map_get(&module->fundecls_index, SYM_MAIN);
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        FunctionDeclaration* fundecl = &module->fundecls[i];
+
+        tree->functions[i] = (FlatFunction) {
+            .body = tree->nodes_size,
+            .args_size = fundecl->args_size,
+            .slots_size = fundecl->slots_size,
+        };
+
+        lower_block(tree, module, fundecl->block, true);
+    }
+}
+
+void flat_tree_free(FlatTree* tree) {
+    assert(tree != NULL);
+
+    free(tree->nodes);
+    free(tree->constants);
+    free(tree->fields);
+    free(tree->functions);
+
+    *tree = (FlatTree) {0};
+}
+
+#define SLOT(base, slot) (engine->frames[(base) + (slot)])
+
+// the child after child, skipping its subtree.
+#define NEXT(child) ((child) + engine->nodes[child].size)
+
+static int push_frame(FlatEngine* engine, int slots_size) {
+    int base = engine->frames_size;
+    int size = base + slots_size;
+
+    if (size > engine->frames_cap) {
+        while (engine->frames_cap < size) {
+            engine->frames_cap = engine->frames_cap ? engine->frames_cap * 2 : 1024;
+        }
+
+        engine->frames = realloc(engine->frames, sizeof(Object) * engine->frames_cap);
+        if (!engine->frames) {
+            error_and_die("cannot allocate memory");
+        }
+
+        engine->stats.allocations++;
+    }
+
+    // unassigned slots read as integer zero, just like a fresh let binding.
+    for (int i = base; i < size; i++) {
+        engine->frames[i] = object_small_int(0);
+    }
+
+    engine->frames_size = size;
+
+    if (size > engine->stats.frames_peak) {
+        engine->stats.frames_peak = size;
+    }
+
+    return base;
+}
+
+static Object run(FlatEngine* engine, uint32_t index, int base);
+
+static Object call_function(FlatEngine* engine, int function, int base) {
+    // calls in tail position reuse the current frame instead of growing the C stack.
+    for (;;) {
+        Object result = run(engine, engine->tree->functions[function].body, base);
+        if (engine->tail_callee < 0) {
+            return result;
+        }
+
+        function = engine->tail_callee;
+        engine->tail_callee = -1;
+
+        // the callee's frame sits right on top of ours, slide its arguments down.
+        FlatFunction* callee = &engine->tree->functions[function];
+        memmove(&SLOT(base, 0), &SLOT(engine->tail_base, 0), sizeof(Object) * callee->args_size);
+
+        engine->frames_size = base + callee->args_size;
+        (void) push_frame(engine, callee->slots_size - callee->args_size);
+    }
+}
+
+static Object run_binary(FlatEngine* engine, const FlatNode* node, uint32_t index, int base) {
+    BinaryExpressionType type = node->op;
+
+    uint32_t lhs_index = index + 1;
+    Object lhs = run(engine, lhs_index, base);
+
+    // a heap lhs has to stay reachable from the frame stack while rhs runs.
+    if (object_is_heap(lhs)) {
+        int temp = push_frame(engine, 1);
+        SLOT(temp, 0) = lhs;
+
+        Object rhs = run(engine, NEXT(lhs_index), base);
+
+        engine->frames_size = temp;
+
+        return perform_binary(&engine->heap, type, lhs, rhs);
+    }
+
+    Object rhs = run(engine, NEXT(lhs_index), base);
+
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {
+        int64_t a = object_as_small_int(lhs);
+        int64_t b = object_as_small_int(rhs);
+
+        switch (type) {
+            case BIN_ADD: return heap_make_int(&engine->heap, a + b);
+            case BIN_SUB: return heap_make_int(&engine->heap, a - b);
+            case BIN_MUL: return heap_make_int(&engine->heap, a * b);
+            case BIN_DIV: return heap_make_int(&engine->heap, a / b);
+            case BIN_EQU: return object_small_int(a == b);
+            case BIN_NEQU: return object_small_int(a != b);
+            case BIN_GT: return object_small_int(a > b);
+            case BIN_LT: return object_small_int(a < b);
+            case BIN_GTEQ: return object_small_int(a >= b);
+            case BIN_LTEQ: return object_small_int(a <= b);
+            case BIN_AND: return object_small_int(a && b);
+            case BIN_OR: return object_small_int(a || b);
+        }
+    }
+
+    if (object_is_float(lhs) && object_is_float(rhs)) {
+        double a = object_as_float(lhs);
+        double b = object_as_float(rhs);
+
+        switch (type) {
+            case BIN_ADD: return object_float(a + b);
+            case BIN_SUB: return object_float(a - b);
+            case BIN_MUL: return object_float(a * b);
+            case BIN_DIV: return object_float(a / b);
+            case BIN_EQU: return object_small_int(a == b);
+            case BIN_NEQU: return object_small_int(a != b);
+            case BIN_GT: return object_small_int(a > b);
+            case BIN_LT: return object_small_int(a < b);
+            case BIN_GTEQ: return object_small_int(a >= b);
+            case BIN_LTEQ: return object_small_int(a <= b);
+            case BIN_AND: return object_small_int(a && b);
+            case BIN_OR: return object_small_int(a || b);
+        }
+    }
+
+    return perform_binary(&engine->heap, type, lhs, rhs);
+}
+
+static Object run_call(FlatEngine* engine, const FlatNode* node, uint32_t index, int base) {
+    FlatFunction* callee = &engine->tree->functions[node->arg];
+    int frame = push_frame(engine, callee->slots_size);
+
+    uint32_t child = index + 1;
+    for (uint32_t i = 0; i < node->count; i++) {
+        // running the argument may grow the frame stack, so store it afterwards.
+        Object object = run(engine, child, base);
+        SLOT(frame, i) = object;
+
+        child = NEXT(child);
+    }
+
+    engine->stats.calls++;
+
+    // a tail call pushes the callee's frame and hands it back to call_function.
+    if (node->kind == FLAT_TAIL_CALL) {
+        engine->tail_callee = node->arg;
+        engine->tail_base = frame;
+
+        return object_void();
+    }
+
+    Object result = call_function(engine, node->arg, frame);
+    engine->frames_size = frame;
+
+    return result;
+}
+
+NORETURN static void bad_call(FlatEngine* engine, const FlatNode* node) {
+    Symbol symbol = node->arg;
+
+    if (symbol == SYM_PRINT) {
+        error_and_die("print expected: %d arguments but got: %d", 1, node->count);
+    }
+
+    FunctionDeclaration* fun = module_find_fundecl(engine->module, symbol);
+    if (!fun) {
+        error_and_die("no such function: "SPAN_FMT, SPAN_ARG(symbol_span(symbol)));
+    }
+
+    error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(fun->id), fun->args_size, node->count);
+}
+
+NORETURN static void bad_record(FlatEngine* engine, const FlatNode* node) {
+    Span id = symbol_span(node->arg);
+
+    Record* record = module_find_record(engine->module, node->arg);
+    if (!record) {
+        error_and_die("no such record: "SPAN_FMT, SPAN_ARG(id));
+    }
+
+    error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(id), record->fields_size, node->count);
+}
+
+static Object run_record(FlatEngine* engine, const FlatNode* node, uint32_t index, int base) {
+    // the fields are kept on the frame stack until the record exists.
+    int fields = push_frame(engine, node->count);
+
+    uint32_t child = index + 1;
+    for (uint32_t i = 0; i < node->count; i++) {
+        Object object = run(engine, child, base);
+        SLOT(fields, i) = object;
+
+        child = NEXT(child);
+    }
+
+    ObjRecord* objrecord = heap_alloc_record(&engine->heap, &engine->module->records[node->arg]);
+    memcpy(objrecord->fields, &SLOT(fields, 0), sizeof(Object) * node->count);
+
+    engine->frames_size = fields;
+    engine->stats.allocations++;
+
+    return object_record(objrecord);
+}
+
+static Object run_field(FlatEngine* engine, const FlatNode* node, uint32_t index, int base) {
+    FieldAccess* field_access = &engine->fields[node->arg];
+    Object object = run(engine, index + 1, base);
+
+    if (object_is_record(object) && object_as_record(object)->shape == field_access->cached_shape) {
+        return object_as_record(object)->fields[field_access->cached_offset];
+    }
+
+    engine->stats.field_cache_misses++;
+
+    return object_as_record(object)->fields[object_field_offset(&object, field_access)];
+}
+
+static Object run(FlatEngine* engine, uint32_t index, int base) {
+    const FlatNode* node = &engine->nodes[index];
+
+    switch (node->kind) {
+        case FLAT_CONSTANT:
+            return engine->constants[node->arg];
+        case FLAT_LOAD:
+            return SLOT(base, node->arg);
+        case FLAT_STORE: {
+            Object object = run(engine, index + 1, base);
+            SLOT(base, node->arg) = object;
+            return object_void();
+        }
+        case FLAT_RESET:
+            SLOT(base, node->arg) = object_small_int(0);
+            return object_void();
+        case FLAT_BINARY:
+            return run_binary(engine, node, index, base);
+        case FLAT_CALL:
+        case FLAT_TAIL_CALL:
+            return run_call(engine, node, index, base);
+        case FLAT_BAD_CALL:
+            bad_call(engine, node);
+        case FLAT_PRINT: {
+            Object object = run(engine, index + 1, base);
+
+            int frame = push_frame(engine, 1);
+            SLOT(frame, 0) = object;
+
+            object_print(&SLOT(frame, 0));
+            printf("\n");
+
+            engine->frames_size = frame;
+
+            return object_void();
+        }
+        case FLAT_RECORD:
+            return run_record(engine, node, index, base);
+        case FLAT_BAD_RECORD:
+            bad_record(engine, node);
+        case FLAT_FIELD:
+            return run_field(engine, node, index, base);
+        case FLAT_LET: {
+            uint32_t child = index + 1;
+            for (uint32_t i = 0; i < node->count; i++) {
+                (void) run(engine, child, base);
+                child = NEXT(child);
+            }
+
+            return object_void();
+        }
+        case FLAT_IF: {
+            uint32_t condition = index + 1;
+
+            Object expr = run(engine, condition, base);
+            if (!object_is_int(expr)) {
+                error_and_die("if expressions should be boolean");
+            }
+
+            uint32_t true_block = NEXT(condition);
+
+            return run(engine, object_as_int(expr) ? true_block : NEXT(true_block), base);
+        }
+        case FLAT_BLOCK: {
+            uint32_t child = index + 1;
+            for (uint32_t i = 0; i < node->count - 1; i++) {
+                (void) run(engine, child, base);
+                child = NEXT(child);
+            }
+
+            return run(engine, child, base);
+        }
+        case FLAT_MISSING_VALUE:
+            error_and_die("any block is expected to return something");
+        case FLAT_EMPTY_BLOCK:
+            error_and_die("expected expressions");
+    }
+
+    error_and_die("unreachable");
+}
+
+static void mark_flat_roots(Heap* heap, void* context) {
+    FlatEngine* engine = context;
+
+    heap_mark_objects(heap, engine->frames, engine->frames_size);
+}
+
+void flat_engine_init(FlatEngine* engine, FlatTree* tree, Module* module) {
+    assert(engine != NULL);
+    assert(tree != NULL);
+    assert(module != NULL);
+
+    engine->tree = tree;
+    engine->nodes = tree->nodes;
+    engine->module = module;
+
+    arena_init(&engine->arena);
+
+    engine->constants = arena_alloc(&engine->arena, sizeof(Object) * (tree->constants_size ? tree->constants_size : 1));
+
+    for (int i = 0; i < tree->constants_size; i++) {
+        FlatConstant* constant = &tree->constants[i];
+        engine->constants[i] = constant->is_float ? object_float(constant->floating) : object_static_int(&engine->arena, constant->integer);
+    }
+
+    engine->fields = arena_alloc(&engine->arena, sizeof(FieldAccess) * (tree->fields_size ? tree->fields_size : 1));
+
+    for (int i = 0; i < tree->fields_size; i++) {
+        FlatField* field = &tree->fields[i];
+
+        engine->fields[i] = (FieldAccess) {
+            .expr = NULL,
+            .field = symbol_span(field->symbol),
+            .symbol = field->symbol,
+            .cached_shape = field->record >= 0 ? &module->records[field->record] : NULL,
+            .cached_offset = field->offset,
+        };
+    }
+
+    engine->frames = NULL;
+    engine->frames_size = 0;
+    engine->frames_cap = 0;
+
+    engine->tail_callee = -1;
+    engine->tail_base = 0;
+
+    heap_init(&engine->heap, mark_flat_roots, engine);
+
+    engine->stats = (InterpreterStats) {0};
+}
+
+void flat_engine_deinit(FlatEngine* engine) {
+    assert(engine != NULL);
+
+    if (engine->frames) {
+        free(engine->frames);
+    }
+
+    heap_deinit(&engine->heap);
+    arena_free(&engine->arena);
+}
+
+Object flat_engine_run(FlatEngine* engine) {
+    int entry_point = engine->tree->entry_point;
+    if (entry_point < 0) {
+        error_and_die("no entry main point function");
+    }
+
+    int base = push_frame(engine, engine->tree->functions[entry_point].slots_size);
+    engine->stats.calls++;
+
+    Object return_value = call_function(engine, entry_point, base);
+    engine->frames_size = base;
+
+    if (!object_is_int(return_value)) {
+        error_and_die("main function should return integer");
+    }
+
+    return return_value;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "ast.h"
+#include "gc.h"
+#include "interpreter.h"
+#include "object.h"
+
+typedef enum {
+    FLAT_CONSTANT,      // arg: constant index
+    FLAT_LOAD,          // arg: slot
+    FLAT_STORE,         // arg: slot, the assigned expression
+    FLAT_RESET,         // arg: slot, let bindings start out as integer zero
+    FLAT_BINARY,        // op, lhs and rhs
+    FLAT_CALL,          // arg: function index, one child per argument
+    FLAT_TAIL_CALL,     // the same in tail position, replaces the current frame
+    FLAT_BAD_CALL,      // arg: symbol, count: arguments given, fails when reached
+    FLAT_PRINT,         // the printed expression
+    FLAT_RECORD,        // arg: record index, one child per field
+    FLAT_BAD_RECORD,    // arg: symbol, count: arguments given, fails when reached
+    FLAT_FIELD,         // arg: field site index, the record expression
+    FLAT_LET,           // resets then stores
+    FLAT_IF,            // condition, true block, false block
+    FLAT_BLOCK,         // statements, the last one gives the value
+    FLAT_MISSING_VALUE, // a block ending in a let block
+    FLAT_EMPTY_BLOCK,   // a block without statements, fails when reached
+} FlatKind;
+
+// one AST node. the children of a node follow it directly, each one followed by
+// its own subtree, so a subtree is a contiguous range and the next sibling of a
+// node is size nodes further on.
+typedef struct {
+    uint8_t kind;
+    uint8_t op; // BinaryExpressionType of FLAT_BINARY
+
+    uint32_t size; // nodes in the subtree, this one included
+    uint32_t count; // children
+    int32_t arg;
+} FlatNode;
+
+typedef struct {
+    bool is_float;
+    int64_t integer;
+    double floating;
+} FlatConstant;
+
+// a field access site, with the record the resolver found as the only one
+// declaring the field.
+typedef struct {
+    Symbol symbol;
+    int32_t record; // -1 when unknown
+    int32_t offset;
+} FlatField;
+
+typedef struct {
+    uint32_t body; // the root of the function's nodes
+    int32_t args_size;
+    int32_t slots_size;
+} FlatFunction;
+
+// a resolved module with the nodes of every function laid out one function after
+// another in a single pool. nothing in it is a pointer, so the arrays can be
+// copied or written out as they are and stay valid.
+typedef struct {
+    FlatNode* nodes;
+    int nodes_size;
+    int nodes_cap;
+
+    FlatConstant* constants;
+    int constants_size;
+    int constants_cap;
+
+    FlatField* fields;
+    int fields_size;
+    int fields_cap;
+
+    FlatFunction* functions; // parallel to module->fundecls
+    int functions_size;
+
+    int entry_point; // -1 without a main function
+} FlatTree;
+
+// lowers every function of the resolved module.
+void flat_tree_build(FlatTree* tree, Module* module);
+void flat_tree_free(FlatTree* tree);
+
+// runs a flat tree, the module it was built from provides the record shapes.
+typedef struct {
+    FlatTree* tree;
+    const FlatNode* nodes;
+
+    Module* module;
+
+    // wide integer constants are boxed once, up front.
+    Arena arena;
+    Object* constants;
+
+    FieldAccess* fields; // the inline cache of every field site
+
+    // slots of every live frame, bump allocated and reused across calls.
+    Object* frames;
+    int frames_size;
+    int frames_cap;
+
+    // set by a call in tail position, whose frame is pushed but not entered yet.
+    int tail_callee;
+    int tail_base;
+
+    // records are collected, the frame stack is the root set.
+    Heap heap;
+
+    InterpreterStats stats;
+} FlatEngine;
+
+void flat_engine_init(FlatEngine* engine, FlatTree* tree, Module* module);
+void flat_engine_deinit(FlatEngine* engine);
+
+Object flat_engine_run(FlatEngine* engine);
@@ -0,0 +1,190 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "gc.h"
+
+#define HEAP_MIN_COLLECTION (1024 * 1024)
+
+void heap_init(Heap* heap, MarkRootsFunction mark_roots, void* context) {
+    assert(heap != NULL);
+
+    heap->objects = NULL;
+
+    heap->bytes = 0;
+    heap->next_collection = HEAP_MIN_COLLECTION;
+    heap->limit = 0;
+    heap->stress = false;
+
+    heap->gray = NULL;
+    heap->gray_size = 0;
+    heap->gray_cap = 0;
+
+    heap->mark_roots = mark_roots;
+    heap->context = context;
+
+    heap->stats = (HeapStats) {0};
+}
+
+void heap_deinit(Heap* heap) {
+    assert(heap != NULL);
+
+    Obj* object = heap->objects;
+    while (object) {
+        Obj* next = object->next;
+        free(object);
+        object = next;
+    }
+
+    if (heap->gray) {
+        free(heap->gray);
+    }
+
+    heap->objects = NULL;
+    heap->bytes = 0;
+}
+
+static size_t record_size(Record* shape) {
+    return sizeof(ObjRecord) + sizeof(Object) * shape->fields_size;
+}
+
+static size_t object_size(Obj* object) {
+    if (object->type == OBJ_RECORD) {
+        return record_size(((ObjRecord*) object)->shape);
+    }
+
+    return sizeof(ObjInt);
+}
+
+static Obj* heap_alloc(Heap* heap, ObjectType type, size_t size) {
+    if (heap->stress || heap->bytes + size > heap->next_collection) {
+        heap_collect(heap);
+    }
+
+    if (heap->limit && heap->bytes + size > heap->limit) {
+        error_and_die("out of memory: heap limit of %zu bytes exceeded", heap->limit);
+    }
+
+    Obj* object = malloc(size);
+    if (!object) {
+        error_and_die("cannot allocate memory");
+    }
+
+    object->next = heap->objects;
+    object->type = type;
+    object->marked = false;
+
+    heap->objects = object;
+    heap->bytes += size;
+
+    heap->stats.objects_allocated++;
+    heap->stats.bytes_allocated += size;
+
+    if (heap->bytes > heap->stats.bytes_peak) {
+        heap->stats.bytes_peak = heap->bytes;
+    }
+
+    return object;
+}
+
+ObjRecord* heap_alloc_record(Heap* heap, Record* shape) {
+    assert(heap != NULL);
+    assert(shape != NULL);
+
+    ObjRecord* record = (ObjRecord*) heap_alloc(heap, OBJ_RECORD, record_size(shape));
+    record->shape = shape;
+
+    return record;
+}
+
+ObjInt* heap_alloc_int(Heap* heap, int64_t value) {
+    assert(heap != NULL);
+
+    ObjInt* box = (ObjInt*) heap_alloc(heap, OBJ_INT, sizeof(ObjInt));
+    box->value = value;
+
+    return box;
+}
+
+static void heap_mark_object(Heap* heap, Object* object) {
+    if (!object_is_heap(*object))
+        return;
+
+    Obj* obj = object_as_obj(*object);
+    if (obj->marked)
+        return;
+
+    obj->marked = true;
+
+    // boxed integers have nothing to trace.
+    if (obj->type != OBJ_RECORD)
+        return;
+
+    if (heap->gray_size >= heap->gray_cap) {
+        heap->gray_cap = heap->gray_cap ? heap->gray_cap * 2 : 256;
+        heap->gray = realloc(heap->gray, sizeof(ObjRecord*) * heap->gray_cap);
+        if (!heap->gray) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    heap->gray[heap->gray_size++] = (ObjRecord*) obj;
+}
+
+void heap_mark_objects(Heap* heap, Object* objects, int objects_size) {
+    for (int i = 0; i < objects_size; i++) {
+        heap_mark_object(heap, &objects[i]);
+    }
+}
+
+static void heap_trace(Heap* heap) {
+    // an explicit gray stack, so long linked structures don't recurse on the C stack.
+    while (heap->gray_size > 0) {
+        ObjRecord* record = heap->gray[--heap->gray_size];
+        heap_mark_objects(heap, record->fields, record->shape->fields_size);
+    }
+}
+
+static void heap_sweep(Heap* heap) {
+    Obj** link = &heap->objects;
+
+    while (*link) {
+        Obj* object = *link;
+
+        if (object->marked) {
+            object->marked = false;
+            link = &object->next;
+        } else {
+            size_t size = object_size(object);
+
+            *link = object->next;
+            free(object);
+
+            heap->bytes -= size;
+            heap->stats.objects_freed++;
+            heap->stats.bytes_freed += size;
+        }
+    }
+}
+
+void heap_collect(Heap* heap) {
+    assert(heap != NULL);
+
+    if (heap->mark_roots) {
+        heap->mark_roots(heap, heap->context);
+    }
+
+    heap_trace(heap);
+    heap_sweep(heap);
+
+    heap->next_collection = heap->bytes * 2;
+    if (heap->next_collection < HEAP_MIN_COLLECTION) {
+        heap->next_collection = HEAP_MIN_COLLECTION;
+    }
+
+    if (heap->limit && heap->next_collection > heap->limit) {
+        heap->next_collection = heap->limit;
+    }
+
+    heap->stats.collections++;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "object.h"
+
+typedef struct Heap_t Heap;
+
+// called at the start of every collection to mark everything the runtime can still reach.
+typedef void (*MarkRootsFunction)(Heap* heap, void* context);
+
+typedef struct {
+    long collections;
+    long objects_allocated;
+    long objects_freed;
+
+    size_t bytes_allocated;
+    size_t bytes_freed;
+    size_t bytes_peak;
+} HeapStats;
+
+// precise mark and sweep heap for record instances and boxed integers.
+struct Heap_t {
+    Obj* objects;
+
+    size_t bytes;           // currently owned by the heap
+    size_t next_collection; // collect once an allocation would cross it
+    size_t limit;           // hard cap on live bytes, zero means unbounded
+    bool stress;            // collect before every allocation
+
+    ObjRecord** gray;
+    int gray_size;
+    int gray_cap;
+
+    MarkRootsFunction mark_roots;
+    void* context;
+
+    HeapStats stats;
+};
+
+void heap_init(Heap* heap, MarkRootsFunction mark_roots, void* context);
+void heap_deinit(Heap* heap);
+
+// the fields are left uninitialized, fill them in before the next allocation.
+ObjRecord* heap_alloc_record(Heap* heap, Record* shape);
+ObjInt* heap_alloc_int(Heap* heap, int64_t value);
+
+// integers stay inline when they fit, so only overflowing arithmetic allocates.
+static inline Object heap_make_int(Heap* heap, int64_t value) {
+    if (object_fits_small_int(value)) {
+        return object_small_int(value);
+    }
+
+    return object_boxed_int(heap_alloc_int(heap, value));
+}
+
+void heap_mark_objects(Heap* heap, Object* objects, int objects_size);
+void heap_collect(Heap* heap);
@@ -1,144 +1,97 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "common.h"
 #include "interpreter.h"
+#include "parallel.h"
 
-static void object_print(Object* object) {
-    switch (object->type) {
-        case OBJ_INT:
-            printf("%ld ", object->as.integer);
-            break;
-        case OBJ_FLOAT:
-            printf("%.*f ", 15, object->as.floating);
-            break;
-        case OBJ_RECORD: {
-            ObjRecord* record = &object->as.record;
-
-            printf(SPAN_FMT" [ ", SPAN_ARG(record->id));
-            for (int i = 0; i < record->variables_size; i++) {
-                printf(""SPAN_FMT": ", SPAN_ARG(record->variables[i].id));
-                object_print(&record->variables[i].object);
-            }
-            printf("] ");
-            break;
-        }
-        case OBJ_VOID:
-            error_and_die("cannot print void value");
-    }
-}
+#define SLOT(scope, slot) (interpreter->frames[(scope)->base + (slot)])
 
 /* native functions are defined here */
 static void basilisk_print(Interpreter* interpreter, Scope* scope) {
-    Variable* arg0 = scope_find_variable(scope, span_from_cstr("arg0"));
-    if (!arg0) {
+    if (scope->slots_size != 1) {
         error_and_die("scope is not set correctly");
     }
 
-    object_print(&arg0->object);
+    object_print(&SLOT(scope, 0));
     printf("\n");
 }
 
-#define PERFORM_BINOP(op) \
-    switch (lhs.type) { \
-        case OBJ_INT: {\
-            int64_t left = lhs.as.integer;\
-            int64_t right = rhs.as.integer;\
-            return (Object) {\
-                .type = lhs.type,\
-                .as.integer = left op right,\
-            };\
-        }\
-        case OBJ_FLOAT: {\
-            double left = lhs.as.floating;\
-            double right = rhs.as.floating;\
-            return (Object) {\
-                .type = lhs.type,\
-                .as.floating = left op right,\
-            };\
-        }\
-        default: {\
-            error_and_die("user defined types / void doesn't support any binary operator");\
-        }\
-    }\
-
-#define PERFORM_BOOLBINOP(op) \
-    switch (lhs.type) { \
-        case OBJ_INT: {\
-            int64_t left = lhs.as.integer;\
-            int64_t right = rhs.as.integer;\
-            return (Object) {\
-                .type = OBJ_INT,\
-                .as.integer = left op right,\
-            };\
-        }\
-        case OBJ_FLOAT: {\
-            double left = lhs.as.floating;\
-            double right = rhs.as.floating;\
-            return (Object) {\
-                .type = OBJ_INT,\
-                .as.integer = left op right,\
-            };\
-        }\
-        default: {\
-            error_and_die("user defined types / void doesn't support any binary operator");\
-        }\
-    }\
+// pushes a frame for the called function and evaluates the arguments into it.
+static FunctionDeclaration* push_call_frame(Interpreter* interpreter, FunctionCall* funcall, Scope* parent_scope, Scope* scope) {
+    FunctionDeclaration* fun = interpreter_find_fundecl(interpreter, funcall->symbol);
+    if (!fun) {
+        error_and_die("no such function: "SPAN_FMT, SPAN_ARG(funcall->id));
+    }
+
+    if (funcall->args_size != fun->args_size) {
+        error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(fun->id), fun->args_size, funcall->args_size);
+    }
+
+    *scope = interpreter_push_frame(interpreter, fun->slots_size);
+
+    if (interpreter->worker && parallel_evaluate(interpreter, funcall->args, funcall->args_size, parent_scope, scope)) {
+        interpreter->stats.calls++;
+        return fun;
+    }
+
+    for (int i = 0; i < fun->args_size; i++) {
+        // evaluating the argument may grow the frame stack, so store it afterwards.
+        Object object = execute_expression(interpreter, funcall->args[i], parent_scope);
+        SLOT(scope, i) = object;
+    }
+
+    interpreter->stats.calls++;
+
+    return fun;
+}
 
 static Object execute_funcall(Interpreter* interpreter, FunctionCall* funcall, Scope* parent_scope) {
-    if (span_equals(funcall->id, span_from_cstr("print"))) {
+    if (funcall->symbol == SYM_PRINT) {
         if (funcall->args_size != 1) {
             error_and_die("print expected: %d arguments but got: %d", 1, funcall->args_size);
         }
 
-        Scope* scope = scope_make();
-
         Object object = execute_expression(interpreter, funcall->args[0], parent_scope);
 
-        scope_append_variable(scope, (Variable) {
-            .id = span_from_cstr("arg0"),
-            .object = object,
-        });
+        Scope scope = interpreter_push_frame(interpreter, 1);
+        SLOT(&scope, 0) = object;
 
-        basilisk_print(interpreter, scope);
+        basilisk_print(interpreter, &scope);
 
-        scope_free(scope);
+        interpreter_pop_frame(interpreter, &scope);
 
-        return (Object) {
-            .type = OBJ_VOID,
-        };
+        return object_void();
     } else {
-        FunctionDeclaration* fun = interpreter_find_fundecl(interpreter, funcall->id);
-        if (!fun) {
-            error_and_die("no such function: "SPAN_FMT, SPAN_ARG(funcall->id));
-        }
+        Scope scope;
+        FunctionDeclaration* fun = push_call_frame(interpreter, funcall, parent_scope, &scope);
 
-        if (funcall->args_size != fun->args_size) {
-            error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(fun->id), fun->args_size, funcall->args_size);
-        }
+        Memo* memo = interpreter->memo;
+        bool memoized = memo && memo_enabled(memo, fun);
 
-        Scope* scope = scope_make();
+        Object result;
+        if (memoized && memo_lookup(memo, fun, &SLOT(&scope, 0), &result)) {
+            interpreter_pop_frame(interpreter, &scope);
+            return result;
+        }
 
-        for (int i = 0; i < fun->args_size; i++) {
-            Object object = execute_expression(interpreter, funcall->args[i], parent_scope);
+        result = execute_function_declaration(interpreter, fun, &scope);
 
-            scope_append_variable(scope, (Variable) {
-                .id = fun->args[i],
-                .object = object,
-            });
+        // tail calls may have replaced the arguments, the memo kept its own copy.
+        if (memoized) {
+            memo_store(memo, fun, result);
         }
 
-        Object result = execute_function_declaration(interpreter, fun, scope);
-
-        scope_free(scope);
+        interpreter_pop_frame(interpreter, &scope);
 
         return result;
     }
 }
 
 static Object execute_record_creation(Interpreter* interpreter, RecordCreation* record_creation, Scope* scope) {
-    Record* record = interpreter_find_record(interpreter, record_creation->id);
+    Record* record = interpreter_find_record(interpreter, record_creation->symbol);
     if (!record) {
         error_and_die("no such record: "SPAN_FMT, SPAN_ARG(record_creation->id));
     }
@@ -147,350 +100,277 @@ static Object execute_record_creation(Interpreter* interpreter, RecordCreation*
         error_and_die(SPAN_FMT" expected: %d arguments but got: %d", SPAN_ARG(record_creation->id), record->fields_size, record_creation->args_size);
     }
 
-    Variable* variables = NULL;
-    int variables_size = 0;
-    int variables_cap = 0;
+    // the fields are kept on the frame stack until the record exists, so a
+    // collection triggered while evaluating or allocating can see them.
+    Scope fields = interpreter_push_frame(interpreter, record_creation->args_size);
 
     for (int i = 0; i < record_creation->args_size; i++) {
-        if (!variables) {
-            variables_cap = 1;
-            variables = malloc(sizeof(Variable));
-        } else {
-            variables_cap++;
-            variables = realloc(variables, sizeof(Variable) * variables_cap);
-        }
+        Object object = execute_expression(interpreter, record_creation->args[i], scope);
+        SLOT(&fields, i) = object;
+    }
 
-        variables[variables_size++] = (Variable) {
-            .id = record->fields[i],
-            .object = execute_expression(interpreter, record_creation->args[i], scope),
-        };
+    ObjRecord* objrecord = heap_alloc_record(&interpreter->heap, record);
+    memcpy(objrecord->fields, &SLOT(&fields, 0), sizeof(Object) * record->fields_size);
+
+    interpreter_pop_frame(interpreter, &fields);
+    interpreter->stats.allocations++;
+
+    return object_record(objrecord);
+}
+
+static Object execute_field_access(Interpreter* interpreter, FieldAccess* field_access, Scope* scope) {
+    Object object = execute_expression(interpreter, field_access->expr, scope);
+
+    if (object_is_record(object) && object_as_record(object)->shape == field_access->cached_shape) {
+        return object_as_record(object)->fields[field_access->cached_offset];
     }
 
-    return (Object) {
-        .type = OBJ_RECORD,
-        .as.record = (ObjRecord) {
-            .id = record->id,
-            .variables = variables,
-            .variables_size = variables_size,
-            .variables_cap = variables_cap,
-        },
-    };
+    interpreter->stats.field_cache_misses++;
+
+    // the cache is two words, threads sharing the tree only ever read it.
+    if (interpreter->shared) {
+        return object_as_record(object)->fields[object_field_find(&object, field_access)];
+    }
+
+    return object_as_record(object)->fields[object_field_offset(&object, field_access)];
 }
 
 static Object execute_primary(Interpreter* interpreter, Value* value, Scope* scope) {
     switch (value->type) {
         case VAL_INT:
-            return (Object) {
-                .type = OBJ_INT,
-                .as.integer = value->as.integer,
-            };
+            return value->as.boxed ? object_boxed_int(value->as.boxed) : heap_make_int(&interpreter->heap, value->as.integer);
         case VAL_FLOAT:
-            return (Object) {
-                .type = OBJ_FLOAT,
-                .as.floating = value->as.floating,
-            };
-        case VAL_IDENT: {
-            Variable* variable = scope_find_variable(scope, value->as.identifier);
-
-            if (!variable) {
-                error_and_die("no such variable: "SPAN_FMT, SPAN_ARG(value->as.identifier));
-            }
-
-            return variable->object;
+            return object_float(value->as.floating);
+        case VAL_IDENT:
+            return SLOT(scope, value->as.identifier.slot);
         case VAL_FUNCALL:
             return execute_funcall(interpreter, &value->as.funcall, scope);
-            break;
-        }
-        case VAL_RECORD_CREATION: {
+        case VAL_RECORD_CREATION:
             return execute_record_creation(interpreter, &value->as.record_creation, scope);
-            break;
-        }
+        case VAL_FIELD_ACCESS:
+            return execute_field_access(interpreter, &value->as.field_access, scope);
         default:
             error_and_die("unreachable");
     }
 }
 
-static Object execute_binary(Interpreter* interpreter, BinaryExpression* binary, Scope* scope) {
-    switch (binary->type) {
-        case BIN_ADD: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
-
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
-
-            PERFORM_BINOP(+);
-            break;
-        }
-        case BIN_SUB: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
-
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
-
-            PERFORM_BINOP(-);
-            break;
-        }
-        case BIN_MUL: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+// a node that keeps flipping between operand types is left generic for good.
+#define QUICKENING_MAX_DEOPTS 4
+
+// with --threads several interpreters share the tree, a node is only ever
+// rewritten as a whole word so relaxed accesses are enough.
+#define QUICKENING_LOAD(binary) __atomic_load_n(&(binary)->quickening, __ATOMIC_RELAXED)
+#define QUICKENING_STORE(binary, value) __atomic_store_n(&(binary)->quickening, (value), __ATOMIC_RELAXED)
+
+static Object perform_int_binary(Interpreter* interpreter, BinaryExpressionType type, int64_t lhs, int64_t rhs) {
+    switch (type) {
+        case BIN_ADD: return heap_make_int(&interpreter->heap, lhs + rhs);
+        case BIN_SUB: return heap_make_int(&interpreter->heap, lhs - rhs);
+        case BIN_MUL: return heap_make_int(&interpreter->heap, lhs * rhs);
+        case BIN_DIV: return heap_make_int(&interpreter->heap, lhs / rhs);
+        case BIN_EQU: return object_small_int(lhs == rhs);
+        case BIN_NEQU: return object_small_int(lhs != rhs);
+        case BIN_GT: return object_small_int(lhs > rhs);
+        case BIN_LT: return object_small_int(lhs < rhs);
+        case BIN_GTEQ: return object_small_int(lhs >= rhs);
+        case BIN_LTEQ: return object_small_int(lhs <= rhs);
+        case BIN_AND: return object_small_int(lhs && rhs);
+        case BIN_OR: return object_small_int(lhs || rhs);
+    }
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+    error_and_die("unreachable");
+}
 
-            PERFORM_BINOP(*);
-            break;
-        }
-        case BIN_DIV: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+static Object perform_float_binary(BinaryExpressionType type, double lhs, double rhs) {
+    switch (type) {
+        case BIN_ADD: return object_float(lhs + rhs);
+        case BIN_SUB: return object_float(lhs - rhs);
+        case BIN_MUL: return object_float(lhs * rhs);
+        case BIN_DIV: return object_float(lhs / rhs);
+        case BIN_EQU: return object_small_int(lhs == rhs);
+        case BIN_NEQU: return object_small_int(lhs != rhs);
+        case BIN_GT: return object_small_int(lhs > rhs);
+        case BIN_LT: return object_small_int(lhs < rhs);
+        case BIN_GTEQ: return object_small_int(lhs >= rhs);
+        case BIN_LTEQ: return object_small_int(lhs <= rhs);
+        case BIN_AND: return object_small_int(lhs && rhs);
+        case BIN_OR: return object_small_int(lhs || rhs);
+    }
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+    error_and_die("unreachable");
+}
 
-            PERFORM_BINOP(/);
-            break;
-        }
-        case BIN_EQU: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+static void quicken_binary(Interpreter* interpreter, BinaryExpression* binary, Object lhs, Object rhs) {
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {
+        QUICKENING_STORE(binary, QUICK_INT);
+    } else if (object_is_float(lhs) && object_is_float(rhs)) {
+        QUICKENING_STORE(binary, QUICK_FLOAT);
+    } else {
+        return;
+    }
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+    interpreter->stats.quickenings++;
+}
 
-            PERFORM_BOOLBINOP(==);
-            break;
-        }
-        case BIN_NEQU: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+static void deoptimize_binary(Interpreter* interpreter, BinaryExpression* binary) {
+    int deopts = __atomic_add_fetch(&binary->deopts, 1, __ATOMIC_RELAXED);
+    QUICKENING_STORE(binary, deopts >= QUICKENING_MAX_DEOPTS ? QUICK_GENERIC : QUICK_NONE);
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+    interpreter->stats.deopts++;
+}
 
-            PERFORM_BOOLBINOP(!=);
-            break;
+static Object execute_binary(Interpreter* interpreter, BinaryExpression* binary, Scope* scope) {
+    if (interpreter->worker) {
+        Object result;
+        if (parallel_binary(interpreter, binary, scope, &result)) {
+            return result;
         }
-        case BIN_GT: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+    }
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
+    Object lhs = execute_expression(interpreter, binary->lhs, scope);
+    Object rhs;
+
+    // the quickened variants guard on the operand types and skip every other check,
+    // a failing guard sends the node back to the generic path below.
+    switch (QUICKENING_LOAD(binary)) {
+        case QUICK_INT:
+            if (object_is_small_int(lhs)) {
+                rhs = execute_expression(interpreter, binary->rhs, scope);
+                if (object_is_small_int(rhs)) {
+                    return perform_int_binary(interpreter, binary->type, object_as_small_int(lhs), object_as_small_int(rhs));
+                }
+
+                deoptimize_binary(interpreter, binary);
+                return perform_binary(&interpreter->heap, binary->type, lhs, rhs);
             }
 
-            PERFORM_BOOLBINOP(>);
+            deoptimize_binary(interpreter, binary);
             break;
-        }
-        case BIN_LT: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
-
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
+        case QUICK_FLOAT:
+            if (object_is_float(lhs)) {
+                rhs = execute_expression(interpreter, binary->rhs, scope);
+                if (object_is_float(rhs)) {
+                    return perform_float_binary(binary->type, object_as_float(lhs), object_as_float(rhs));
+                }
+
+                deoptimize_binary(interpreter, binary);
+                return perform_binary(&interpreter->heap, binary->type, lhs, rhs);
             }
 
-            PERFORM_BOOLBINOP(<);
+            deoptimize_binary(interpreter, binary);
             break;
-        }
-        case BIN_GTEQ: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
-
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
-
-            PERFORM_BOOLBINOP(>=);
+        case QUICK_NONE:
+        case QUICK_GENERIC:
             break;
-        }
-        case BIN_LTEQ: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+    }
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+    if (object_is_heap(lhs)) {
+        // evaluating rhs may collect, keep lhs reachable from the frame stack meanwhile.
+        Scope temp = interpreter_push_frame(interpreter, 1);
+        SLOT(&temp, 0) = lhs;
 
-            PERFORM_BOOLBINOP(<=);
-            break;
-        }
-        case BIN_AND: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
-
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+        rhs = execute_expression(interpreter, binary->rhs, scope);
 
-            PERFORM_BOOLBINOP(&&);
-            break;
-        }
-        case BIN_OR: {
-            Object lhs = execute_expression(interpreter, binary->lhs, scope);
-            Object rhs = execute_expression(interpreter, binary->rhs, scope);
+        interpreter_pop_frame(interpreter, &temp);
+    } else {
+        rhs = execute_expression(interpreter, binary->rhs, scope);
+    }
 
-            if (lhs.type != rhs.type) {
-                error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", lhs.type, rhs.type);
-            }
+    Object result = perform_binary(&interpreter->heap, binary->type, lhs, rhs);
 
-            PERFORM_BOOLBINOP(||);
-            break;
-        }
+    if (QUICKENING_LOAD(binary) == QUICK_NONE) {
+        quicken_binary(interpreter, binary, lhs, rhs);
     }
 
-    error_and_die("unreachable");
+    return result;
 }
 
-void obj_record_free(ObjRecord* objrecord) {
-    assert(objrecord != NULL);
-
-    if (objrecord->variables) {
-        for (int i = 0; i < objrecord->variables_size; i++) {
-            variable_free(&objrecord->variables[i]);
-        }
-    }
-}
+static void mark_interpreter_roots(Heap* heap, void* context) {
+    Interpreter* interpreter = context;
 
-void object_free(Object* object) {
-    assert(object != NULL);
+    heap_mark_objects(heap, interpreter->frames, interpreter->frames_size);
 
-    switch (object->type) {
-        case OBJ_RECORD: {
-            obj_record_free(&object->as.record);
-            break;
-        }
-        default:
-            break;
+    if (interpreter->memo) {
+        memo_mark(interpreter->memo, heap);
     }
 }
 
-void variable_free(Variable* variable) {
-    assert(variable != NULL);
+void interpreter_init(Interpreter* interpreter, Module* module) {
+    assert(interpreter != NULL);
+    assert(module != NULL);
 
-    object_free(&variable->object);
-}
+    interpreter->module = module;
 
-Scope* scope_make() {
-    Scope* scope = malloc(sizeof(Scope));
+    interpreter->frames = NULL;
+    interpreter->frames_size = 0;
+    interpreter->frames_cap = 0;
 
-    scope->children = NULL;
-    scope->children_size = 0;
-    scope->children_cap = 0;
+    heap_init(&interpreter->heap, mark_interpreter_roots, interpreter);
 
-    scope->variables = NULL;
-    scope->variables_size = 0;
-    scope->variables_cap = 0;
+    interpreter->stats = (InterpreterStats) {0};
 
-    return scope;
+    interpreter->jit = NULL;
+    interpreter->memo = NULL;
+    interpreter->worker = NULL;
+    interpreter->shared = false;
 }
 
-void scope_free(Scope* scope) {
-    if (scope->children) {
-        for (int i = 0; i < scope->children_size; i++) {
-            scope_free(scope->children[i]);
-        }
-
-        free(scope->children);
-    }
-
-    if (scope->variables) {
-        for (int i = 0; i < scope->variables_size; i++) {
-            variable_free(&scope->variables[i]);
-        }
+void interpreter_deinit(Interpreter* interpreter) {
+    assert(interpreter != NULL);
 
-        free(scope->variables);
+    if (interpreter->frames) {
+        free(interpreter->frames);
     }
 
-    free(scope);
+    heap_deinit(&interpreter->heap);
 }
 
-void scope_append_child(Scope* scope, Scope* child) {
-    assert(scope != NULL);
-    assert(child != NULL);
-
-    if (!scope->children) {
-        scope->children_cap = 1;
-        scope->children = malloc(sizeof(Scope*));
-    } else {
-        scope->children_cap++;
-        scope->children = realloc(scope->children, sizeof(Scope*) * scope->children_cap);
-    }
+Scope interpreter_push_frame(Interpreter* interpreter, int slots_size) {
+    int base = interpreter->frames_size;
+    int size = base + slots_size;
 
-    scope->children[scope->children_size++] = child;
-}
+    if (size > interpreter->frames_cap) {
+        while (interpreter->frames_cap < size) {
+            interpreter->frames_cap = interpreter->frames_cap ? interpreter->frames_cap * 2 : 1024;
+        }
 
-void scope_append_variable(Scope* scope, Variable variable) {
-    assert(scope != NULL);
+        interpreter->frames = realloc(interpreter->frames, sizeof(Object) * interpreter->frames_cap);
+        if (!interpreter->frames) {
+            error_and_die("cannot allocate memory");
+        }
 
-    if (!scope->variables) {
-        scope->variables_cap = 1;
-        scope->variables = malloc(sizeof(Variable));
-    } else {
-        scope->variables_cap++;
-        scope->variables = realloc(scope->variables, sizeof(Variable) * scope->variables_cap);
+        interpreter->stats.allocations++;
     }
 
-    scope->variables[scope->variables_size++] = variable;
-}
+    // unassigned slots read as integer zero, just like a fresh let binding.
+    for (int i = base; i < size; i++) {
+        interpreter->frames[i] = object_small_int(0);
+    }
 
-Variable* scope_find_variable(Scope* scope, Span id) {
-    Variable* variable = NULL;
+    interpreter->frames_size = size;
 
-    for (int i = 0; i < scope->variables_size; i++) {
-        if (span_equals(scope->variables[i].id, id)) {
-            variable = &scope->variables[i];
-        }
+    if (size > interpreter->stats.frames_peak) {
+        interpreter->stats.frames_peak = size;
     }
 
-    return variable;
+    return (Scope) {
+        .base = base,
+        .slots_size = slots_size,
+    };
 }
 
+void interpreter_pop_frame(Interpreter* interpreter, Scope* scope) {
+    assert(interpreter->frames_size == scope->base + scope->slots_size);
 
-void interpreter_init(Interpreter* interpreter, Module* module) {
-    assert(interpreter != NULL);
-    assert(module != NULL);
-
-    interpreter->module = module;
+    interpreter->frames_size = scope->base;
 }
 
-void interpreter_deinit(Interpreter* interpreter) {
-    assert(interpreter != NULL);
-
-    module_free(interpreter->module);
+FunctionDeclaration* interpreter_find_fundecl(Interpreter* interpreter, Symbol symbol) {
+    return module_find_fundecl(interpreter->module, symbol);
 }
 
-FunctionDeclaration* interpreter_find_fundecl(Interpreter* interpreter, Span id) {
-    Module* module = interpreter->module;
-
-    FunctionDeclaration* fundecl = NULL;
-    for (int i = 0; i < module->fundecls_size; i++) {
-        if (span_equals(module->fundecls[i].id, id)) {
-            fundecl = &module->fundecls[i];
-        }
-    }
-
-    return fundecl;
-}
-
-Record* interpreter_find_record(Interpreter* interpreter, Span id) {
-    Module* module = interpreter->module;
-
-    Record* record = NULL;
-    for (int i = 0; i < module->records_size; i++) {
-        if (span_equals(module->records[i].id, id)) {
-            record = &module->records[i];
-        }
-    }
-
-    return record;
+Record* interpreter_find_record(Interpreter* interpreter, Symbol symbol) {
+    return module_find_record(interpreter->module, symbol);
 }
 
 Object execute_expression(Interpreter* interpreter, Expression* expression, Scope* scope) {
@@ -505,19 +385,13 @@ Object execute_expression(Interpreter* interpreter, Expression* expression, Scop
 }
 
 void execute_assignment(Interpreter* interpreter, Assignment* assignment, Scope* scope) {
-    Variable* variable = scope_find_variable(scope, assignment->id);
-    if (!variable) {
-        error_and_die("no such variable: "SPAN_FMT, SPAN_ARG(assignment->id));
-    }
-
-    variable->object = execute_expression(interpreter, assignment->expr, scope);
+    Object object = execute_expression(interpreter, assignment->expr, scope);
+    SLOT(scope, assignment->slot) = object;
 }
 
 void execute_let_block(Interpreter* interpreter, LetBlock* letblock, Scope* scope) {
     for (int i = 0; i < letblock->ids_size; i++) {
-        scope_append_variable(scope, (Variable) {
-            .id = letblock->ids[i],
-        });
+        SLOT(scope, letblock->ids[i].slot) = object_small_int(0);
     }
 
     for (int i = 0; i < letblock->assignments_size; i++) {
@@ -525,20 +399,42 @@ void execute_let_block(Interpreter* interpreter, LetBlock* letblock, Scope* scop
     }
 }
 
-Object execute_if_statement(Interpreter* interpreter, IfStatement* ifstatement, Scope* scope) {
+// a call in tail position whose frame is pushed but which has not been entered yet.
+typedef struct {
+    FunctionDeclaration* fundecl;
+    Scope scope;
+} TailCall;
+
+static bool prepare_tail_call(Interpreter* interpreter, Expression* expression, Scope* parent_scope, TailCall* tail) {
+    if (expression->type != EXPR_PRIMARY || expression->as.primary.type != VAL_FUNCALL)
+        return false;
+
+    FunctionCall* funcall = &expression->as.primary.as.funcall;
+    if (funcall->symbol == SYM_PRINT)
+        return false;
+
+    tail->fundecl = push_call_frame(interpreter, funcall, parent_scope, &tail->scope);
+
+    return true;
+}
+
+static Object execute_block_with_tail(Interpreter* interpreter, Block* block, Scope* scope, TailCall* tail);
+
+static Object execute_if_statement_with_tail(Interpreter* interpreter, IfStatement* ifstatement, Scope* scope, TailCall* tail) {
     Object expr = execute_expression(interpreter, ifstatement->expr, scope);
-    if (expr.type != OBJ_INT) {
+    if (!object_is_int(expr)) {
         error_and_die("if expressions should be boolean");
     }
 
-    if (expr.as.integer) {
-        return execute_block(interpreter, ifstatement->true_block, scope);
+    if (object_as_int(expr)) {
+        return execute_block_with_tail(interpreter, ifstatement->true_block, scope, tail);
     } else {
-        return execute_block(interpreter, ifstatement->false_block, scope);
+        return execute_block_with_tail(interpreter, ifstatement->false_block, scope, tail);
     }
 }
- 
-Object execute_block(Interpreter* interpreter, Block* block, Scope* scope) {
+
+// when tail is not NULL, a call in tail position is not executed but handed back through it.
+static Object execute_block_with_tail(Interpreter* interpreter, Block* block, Scope* scope, TailCall* tail) {
     if (block->children_size < 1) {
         error_and_die("expected expressions");
     }
@@ -559,40 +455,75 @@ Object execute_block(Interpreter* interpreter, Block* block, Scope* scope) {
         }
     }
 
-    if (block->children[block->children_size - 1].type == STMT_EXPRESSION) {
-        return execute_expression(interpreter, block->children[block->children_size - 1].as.expression, scope);
-    } else if (block->children[block->children_size - 1].type == STMT_IF) {
-        return execute_if_statement(interpreter, &block->children[block->children_size - 1].as.ifstatement, scope);
+    Statement* last = &block->children[block->children_size - 1];
+
+    if (last->type == STMT_EXPRESSION) {
+        if (tail && prepare_tail_call(interpreter, last->as.expression, scope, tail)) {
+            return object_void();
+        }
+
+        return execute_expression(interpreter, last->as.expression, scope);
+    } else if (last->type == STMT_IF) {
+        return execute_if_statement_with_tail(interpreter, &last->as.ifstatement, scope, tail);
     } else {
         error_and_die("any block is expected to return something");
     }
 }
 
-Object execute_function_declaration(Interpreter* interpreter, FunctionDeclaration* fundecl, Scope* scope) {
-    Object result = execute_block(interpreter, fundecl->block, scope);
-    return result;
+Object execute_if_statement(Interpreter* interpreter, IfStatement* ifstatement, Scope* scope) {
+    return execute_if_statement_with_tail(interpreter, ifstatement, scope, NULL);
 }
 
-Object execute_module(Interpreter* interpreter) {
-    Module* module = interpreter->module;
-    FunctionDeclaration* entry_point = NULL;
+Object execute_block(Interpreter* interpreter, Block* block, Scope* scope) {
+    return execute_block_with_tail(interpreter, block, scope, NULL);
+}
+
+Object execute_function_declaration(Interpreter* interpreter, FunctionDeclaration* fundecl, Scope* scope) {
+    // calls in tail position reuse the current frame instead of growing the C stack.
+    for (;;) {
+        if (interpreter->jit) {
+            Object result;
+            if (jit_call(interpreter->jit, &interpreter->heap, fundecl, &SLOT(scope, 0), &result)) {
+                return result;
+            }
+        }
+
+        TailCall tail = {
+            .fundecl = NULL,
+        };
 
-    for (int i = 0; i < module->fundecls_size; i++) {
-        FunctionDeclaration* fundecl = &module->fundecls[i];
-        if (span_equals(fundecl->id, span_from_cstr("main"))) {
-            entry_point = fundecl;
+        Object result = execute_block_with_tail(interpreter, fundecl->block, scope, &tail);
+        if (!tail.fundecl) {
+            return result;
         }
+
+        fundecl = tail.fundecl;
+
+        // the callee's frame sits right on top of ours, slide its arguments down.
+        interpreter_pop_frame(interpreter, &tail.scope);
+        memmove(&interpreter->frames[scope->base], &interpreter->frames[tail.scope.base], sizeof(Object) * fundecl->args_size);
+
+        interpreter->frames_size = scope->base + fundecl->args_size;
+        (void) interpreter_push_frame(interpreter, fundecl->slots_size - fundecl->args_size);
+
+        scope->slots_size = fundecl->slots_size;
     }
+}
+
+Object execute_module(Interpreter* interpreter) {
+    FunctionDeclaration* entry_point = interpreter_find_fundecl(interpreter, SYM_MAIN);
 
     if (!entry_point) {
         error_and_die("no entry main point function");
     }
 
-    Scope* scope = scope_make();
-    Object return_value = execute_function_declaration(interpreter, entry_point, scope);
-    scope_free(scope);
+    Scope scope = interpreter_push_frame(interpreter, entry_point->slots_size);
+    interpreter->stats.calls++;
+
+    Object return_value = execute_function_declaration(interpreter, entry_point, &scope);
+    interpreter_pop_frame(interpreter, &scope);
 
-    if (return_value.type != OBJ_INT) {
+    if (!object_is_int(return_value)) {
         error_and_die("main function should return integer");
     }
 
@@ -1,77 +1,70 @@
 #pragma once
 
 #include "ast.h"
+#include "gc.h"
+#include "jit.h"
+#include "memo.h"
+#include "object.h"
+#include "runtime.h"
 
 typedef struct Interpreter_t Interpreter;
 typedef struct Scope_t Scope;
+typedef struct Parallel_t Parallel;
+typedef struct ParallelWorker_t ParallelWorker;
 
 typedef void (*NativeFunction)(Interpreter* interpreter, Scope* scope);
 
-typedef struct Variable_t Variable;
-
-typedef struct {
-    Span id;
-
-    Variable* variables;
-    int variables_size;
-    int variables_cap;
-} ObjRecord;
-
-void obj_record_free(ObjRecord* objrecord);
-
-typedef enum {
-    OBJ_INT,
-    OBJ_FLOAT,
-    OBJ_RECORD,
-    OBJ_VOID,
-} ObjectType;
+// an activation record on the interpreter's frame stack, one slot per
+// argument and let binding as assigned by the resolver.
+struct Scope_t {
+    int base;
+    int slots_size;
+};
 
 typedef struct {
-    ObjectType type;
-
-    union {
-        int64_t integer;
-        double floating;
-        ObjRecord record;
-    } as;
-} Object;
-
-void object_free(Object* object);
+    long calls;
+    long allocations;
+    long field_cache_misses;
+    long quickenings;
+    long deopts;
+    int frames_peak; // highest number of live frame slots
+} InterpreterStats;
 
-struct Variable_t {
-    Span id;
-    Object object;
-};
+struct Interpreter_t {
+    Module* module;
 
-void variable_free(Variable* variable);
+    // slots of every live scope, bump allocated and reused across calls.
+    Object* frames;
+    int frames_size;
+    int frames_cap;
 
-struct Scope_t {
-    Scope** children;
-    int children_size;
-    int children_cap;
+    // records are collected, the frame stack is the root set.
+    Heap heap;
 
-    Variable* variables;
-    int variables_size;
-    int variables_cap;
-};
+    InterpreterStats stats;
 
-Scope* scope_make();
-void scope_free(Scope* scope);
+    // hot numeric functions run natively when set.
+    Jit* jit;
 
-void scope_append_child(Scope* scope, Scope* child);
-void scope_append_variable(Scope* scope, Variable variable);
+    // results of pure functions are reused when set.
+    Memo* memo;
 
-Variable* scope_find_variable(Scope* scope, Span id);
+    // the pool thread running this interpreter with --threads, NULL otherwise.
+    ParallelWorker* worker;
 
-struct Interpreter_t {
-    Module* module;
+    // the module is run by other threads as well, its inline caches are only read.
+    bool shared;
 };
 
+// the module is borrowed, it outlives the interpreter.
 void interpreter_init(Interpreter* interpreter, Module* module);
 void interpreter_deinit(Interpreter* interpreter);
 
-FunctionDeclaration* interpreter_find_fundecl(Interpreter* interpreter, Span id);
-Record* interpreter_find_record(Interpreter* interpreter, Span id);
+Scope interpreter_push_frame(Interpreter* interpreter, int slots_size);
+void interpreter_pop_frame(Interpreter* interpreter, Scope* scope);
+
+FunctionDeclaration* interpreter_find_fundecl(Interpreter* interpreter, Symbol symbol);
+Record* interpreter_find_record(Interpreter* interpreter, Symbol symbol);
 
 Object execute_expression(Interpreter* interpreter, Expression* expression, Scope* scope);
 void execute_assignment(Interpreter* interpreter, Assignment* assignment, Scope* scope);
@@ -0,0 +1,904 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+#define JIT_MAX_ARGS 16
+
+typedef enum {
+    JIT_UNKNOWN,  // not inferred yet, only seen while analysing
+    JIT_NONE,     // never produces a value, a self tail call jumps away
+    JIT_INT,      // an int64_t in rax
+    JIT_FLOAT,    // a double in xmm0
+    JIT_CONFLICT, // a slot holding a different type depending on the branch taken
+} JitType;
+
+typedef enum {
+    SPEC_PENDING,
+    SPEC_COMPILED,
+    SPEC_FAILED,
+} JitSpecState;
+
+// a function declaration compiled for one signature of argument types.
+struct JitSpec_t {
+    JitSpec* next; // other signatures of the same function
+
+    FunctionDeclaration* fundecl;
+    JitType args[JIT_MAX_ARGS];
+    JitType ret;
+
+    JitSpecState state;
+
+    // while compiling, where the code and the C entry start in the unit.
+    size_t offset;
+    size_t enter_offset;
+
+    void* entry; // internal calling convention, arguments pushed on the stack
+    uint64_t (*enter)(const uint64_t* args);
+};
+
+struct JitRegion_t {
+    JitRegion* next;
+    void* code;
+    size_t size;
+};
+
+typedef struct {
+    size_t at; // of the rel32 operand
+    JitSpec* target;
+} JitPatch;
+
+// compiles a unit, the specialization that got hot plus every one it calls that
+// is not compiled yet. bodies are walked until the return types settle, then
+// emitted for real. native frames keep every slot and temporary in memory:
+//   [rbp + 16 + 8 * i]  argument i, pushed by the caller
+//   [rbp - 8 * (j + 1)] let slot j, then the temporaries
+typedef struct {
+    Jit* jit;
+    JitSpec* spec;
+
+    bool final;   // emitting for real, every type has to be known
+    bool failed;  // something unsupported was found, the unit is dropped
+    bool changed; // the last analysis pass learned something
+
+    JitSpec** unit;
+    int unit_size;
+    int unit_cap;
+
+    uint8_t* code;
+    size_t code_size;
+    size_t code_cap;
+
+    JitPatch* patches;
+    int patches_size;
+    int patches_cap;
+
+    JitType* slot_types;
+    int slot_types_cap;
+
+    int lets;
+    int temps;
+    int temps_max;
+
+    size_t body_start;
+} JitCompiler;
+
+static void* jit_realloc(void* ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if (!ptr) {
+        error_and_die("cannot allocate memory");
+    }
+
+    return ptr;
+}
+
+static void fail(JitCompiler* compiler) {
+    compiler->failed = true;
+}
+
+static void emit_bytes(JitCompiler* compiler, const uint8_t* bytes, size_t size) {
+    if (compiler->code_size + size > compiler->code_cap) {
+        while (compiler->code_size + size > compiler->code_cap) {
+            compiler->code_cap = compiler->code_cap ? compiler->code_cap * 2 : 4096;
+        }
+
+        compiler->code = jit_realloc(compiler->code, compiler->code_cap);
+    }
+
+    memcpy(compiler->code + compiler->code_size, bytes, size);
+    compiler->code_size += size;
+}
+
+#define EMIT(compiler, ...) \
+    emit_bytes(compiler, (const uint8_t[]) { __VA_ARGS__ }, sizeof((const uint8_t[]) { __VA_ARGS__ }))
+
+static void emit_u32(JitCompiler* compiler, uint32_t value) {
+    emit_bytes(compiler, (const uint8_t*) &value, sizeof(value));
+}
+
+static void emit_u64(JitCompiler* compiler, uint64_t value) {
+    emit_bytes(compiler, (const uint8_t*) &value, sizeof(value));
+}
+
+static void patch_u32(JitCompiler* compiler, size_t at, uint32_t value) {
+    memcpy(compiler->code + at, &value, sizeof(value));
+}
+
+// points the rel32 operand at `at` to target.
+static void patch_rel32(JitCompiler* compiler, size_t at, size_t target) {
+    patch_u32(compiler, at, (uint32_t) (int32_t) ((int64_t) target - (int64_t) (at + 4)));
+}
+
+static int32_t slot_offset(JitCompiler* compiler, int slot) {
+    int args_size = compiler->spec->fundecl->args_size;
+
+    if (slot < args_size) {
+        return 16 + 8 * slot;
+    }
+
+    return -8 * (slot - args_size + 1);
+}
+
+static int32_t temp_offset(JitCompiler* compiler, int temp) {
+    return -8 * (compiler->lets + temp + 1);
+}
+
+static int push_temp(JitCompiler* compiler) {
+    int temp = compiler->temps++;
+    if (compiler->temps > compiler->temps_max) {
+        compiler->temps_max = compiler->temps;
+    }
+
+    return temp;
+}
+
+static void emit_load(JitCompiler* compiler, JitType type, int32_t offset) {
+    if (type == JIT_INT) {
+        EMIT(compiler, 0x48, 0x8b, 0x85); // mov rax, [rbp + offset]
+        emit_u32(compiler, offset);
+    } else if (type == JIT_FLOAT) {
+        EMIT(compiler, 0xf2, 0x0f, 0x10, 0x85); // movsd xmm0, [rbp + offset]
+        emit_u32(compiler, offset);
+    }
+}
+
+static void emit_store(JitCompiler* compiler, JitType type, int32_t offset) {
+    if (type == JIT_INT) {
+        EMIT(compiler, 0x48, 0x89, 0x85); // mov [rbp + offset], rax
+        emit_u32(compiler, offset);
+    } else if (type == JIT_FLOAT) {
+        EMIT(compiler, 0xf2, 0x0f, 0x11, 0x85); // movsd [rbp + offset], xmm0
+        emit_u32(compiler, offset);
+    }
+}
+
+static void emit_mov_rax_imm(JitCompiler* compiler, uint64_t value) {
+    EMIT(compiler, 0x48, 0xb8); // mov rax, imm64
+    emit_u64(compiler, value);
+}
+
+static JitSpec* find_spec(Jit* jit, FunctionDeclaration* fundecl, JitType* args) {
+    JitSpec* spec = jit->specs[fundecl - jit->module->fundecls];
+
+    for (; spec; spec = spec->next) {
+        if (memcmp(spec->args, args, sizeof(JitType) * fundecl->args_size) == 0) {
+            return spec;
+        }
+    }
+
+    return NULL;
+}
+
+static JitSpec* spec_make(Jit* jit, FunctionDeclaration* fundecl, JitType* args) {
+    JitSpec* spec = jit_realloc(NULL, sizeof(JitSpec));
+    memset(spec, 0, sizeof(JitSpec));
+
+    spec->fundecl = fundecl;
+    memcpy(spec->args, args, sizeof(JitType) * fundecl->args_size);
+    spec->ret = JIT_UNKNOWN;
+    spec->state = SPEC_PENDING;
+
+    JitSpec** specs = &jit->specs[fundecl - jit->module->fundecls];
+    spec->next = *specs;
+    *specs = spec;
+
+    return spec;
+}
+
+static void spec_free(Jit* jit, JitSpec* spec) {
+    JitSpec** link = &jit->specs[spec->fundecl - jit->module->fundecls];
+
+    while (*link != spec) {
+        link = &(*link)->next;
+    }
+
+    *link = spec->next;
+    free(spec);
+}
+
+static void unit_push(JitCompiler* compiler, JitSpec* spec) {
+    if (compiler->unit_size >= compiler->unit_cap) {
+        compiler->unit_cap = compiler->unit_cap ? compiler->unit_cap * 2 : 8;
+        compiler->unit = jit_realloc(compiler->unit, sizeof(JitSpec*) * compiler->unit_cap);
+    }
+
+    compiler->unit[compiler->unit_size++] = spec;
+}
+
+static void patch_push(JitCompiler* compiler, size_t at, JitSpec* target) {
+    if (compiler->patches_size >= compiler->patches_cap) {
+        compiler->patches_cap = compiler->patches_cap ? compiler->patches_cap * 2 : 16;
+        compiler->patches = jit_realloc(compiler->patches, sizeof(JitPatch) * compiler->patches_cap);
+    }
+
+    compiler->patches[compiler->patches_size++] = (JitPatch) {
+        .at = at,
+        .target = target,
+    };
+}
+
+static bool is_value(JitType type) {
+    return type == JIT_INT || type == JIT_FLOAT;
+}
+
+static JitType compile_expression(JitCompiler* compiler, Expression* expression, bool tail);
+static JitType compile_block(JitCompiler* compiler, Block* block, bool tail);
+
+static void compile_int_binary(JitCompiler* compiler, BinaryExpressionType type) {
+    switch (type) {
+        case BIN_ADD: EMIT(compiler, 0x48, 0x01, 0xc8); return;             // add rax, rcx
+        case BIN_SUB: EMIT(compiler, 0x48, 0x29, 0xc8); return;             // sub rax, rcx
+        case BIN_MUL: EMIT(compiler, 0x48, 0x0f, 0xaf, 0xc1); return;       // imul rax, rcx
+        case BIN_DIV: EMIT(compiler, 0x48, 0x99, 0x48, 0xf7, 0xf9); return; // cqo; idiv rcx
+        case BIN_EQU: EMIT(compiler, 0x48, 0x39, 0xc8, 0x0f, 0x94, 0xc0); break; // cmp rax, rcx; sete al
+        case BIN_NEQU: EMIT(compiler, 0x48, 0x39, 0xc8, 0x0f, 0x95, 0xc0); break; // setne al
+        case BIN_GT: EMIT(compiler, 0x48, 0x39, 0xc8, 0x0f, 0x9f, 0xc0); break;   // setg al
+        case BIN_LT: EMIT(compiler, 0x48, 0x39, 0xc8, 0x0f, 0x9c, 0xc0); break;   // setl al
+        case BIN_GTEQ: EMIT(compiler, 0x48, 0x39, 0xc8, 0x0f, 0x9d, 0xc0); break; // setge al
+        case BIN_LTEQ: EMIT(compiler, 0x48, 0x39, 0xc8, 0x0f, 0x9e, 0xc0); break; // setle al
+        case BIN_AND:
+        case BIN_OR:
+            EMIT(compiler, 0x48, 0x85, 0xc0, 0x0f, 0x95, 0xc0); // test rax, rax; setne al
+            EMIT(compiler, 0x48, 0x85, 0xc9, 0x0f, 0x95, 0xc1); // test rcx, rcx; setne cl
+            if (type == BIN_AND) {
+                EMIT(compiler, 0x20, 0xc8); // and al, cl
+            } else {
+                EMIT(compiler, 0x08, 0xc8); // or al, cl
+            }
+            break;
+    }
+
+    EMIT(compiler, 0x0f, 0xb6, 0xc0); // movzx eax, al
+}
+
+// returns the type of the result, comparisons of floats give ints.
+static JitType compile_float_binary(JitCompiler* compiler, BinaryExpressionType type) {
+    switch (type) {
+        case BIN_ADD: EMIT(compiler, 0xf2, 0x0f, 0x58, 0xc1); return JIT_FLOAT; // addsd xmm0, xmm1
+        case BIN_SUB: EMIT(compiler, 0xf2, 0x0f, 0x5c, 0xc1); return JIT_FLOAT; // subsd xmm0, xmm1
+        case BIN_MUL: EMIT(compiler, 0xf2, 0x0f, 0x59, 0xc1); return JIT_FLOAT; // mulsd xmm0, xmm1
+        case BIN_DIV: EMIT(compiler, 0xf2, 0x0f, 0x5e, 0xc1); return JIT_FLOAT; // divsd xmm0, xmm1
+        // unordered compares set ZF, PF and CF, so NaNs are never equal nor ordered.
+        case BIN_EQU:
+            EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+            EMIT(compiler, 0x0f, 0x94, 0xc0, 0x0f, 0x9b, 0xc1, 0x20, 0xc8); // sete al; setnp cl; and al, cl
+            break;
+        case BIN_NEQU:
+            EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+            EMIT(compiler, 0x0f, 0x95, 0xc0, 0x0f, 0x9a, 0xc1, 0x08, 0xc8); // setne al; setp cl; or al, cl
+            break;
+        case BIN_GT: EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc1, 0x0f, 0x97, 0xc0); break;   // ucomisd xmm0, xmm1; seta al
+        case BIN_GTEQ: EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc1, 0x0f, 0x93, 0xc0); break; // ucomisd xmm0, xmm1; setae al
+        case BIN_LT: EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc8, 0x0f, 0x97, 0xc0); break;   // ucomisd xmm1, xmm0; seta al
+        case BIN_LTEQ: EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc8, 0x0f, 0x93, 0xc0); break; // ucomisd xmm1, xmm0; setae al
+        case BIN_AND:
+        case BIN_OR:
+            // a float is true when it is not zero, NaN included.
+            EMIT(compiler, 0x66, 0x0f, 0x57, 0xd2); // xorpd xmm2, xmm2
+            EMIT(compiler, 0x66, 0x0f, 0x2e, 0xc2, 0x0f, 0x95, 0xc0, 0x0f, 0x9a, 0xc2, 0x08, 0xd0); // ucomisd xmm0, xmm2; setne al; setp dl; or al, dl
+            EMIT(compiler, 0x66, 0x0f, 0x2e, 0xca, 0x0f, 0x95, 0xc1, 0x0f, 0x9a, 0xc2, 0x08, 0xd1); // ucomisd xmm1, xmm2; setne cl; setp dl; or cl, dl
+            if (type == BIN_AND) {
+                EMIT(compiler, 0x20, 0xc8); // and al, cl
+            } else {
+                EMIT(compiler, 0x08, 0xc8); // or al, cl
+            }
+            break;
+    }
+
+    EMIT(compiler, 0x0f, 0xb6, 0xc0); // movzx eax, al
+    return JIT_INT;
+}
+
+static bool is_arithmetic(BinaryExpressionType type) {
+    return type == BIN_ADD || type == BIN_SUB || type == BIN_MUL || type == BIN_DIV;
+}
+
+static JitType compile_binary(JitCompiler* compiler, BinaryExpression* binary) {
+    JitType lhs = compile_expression(compiler, binary->lhs, false);
+
+    int temp = push_temp(compiler);
+    emit_store(compiler, lhs, temp_offset(compiler, temp));
+
+    JitType rhs = compile_expression(compiler, binary->rhs, false);
+    compiler->temps--;
+
+    if (lhs == JIT_UNKNOWN || rhs == JIT_UNKNOWN) {
+        if (compiler->final) {
+            fail(compiler);
+        }
+
+        if (!is_arithmetic(binary->type)) {
+            return JIT_INT;
+        }
+
+        return lhs == JIT_UNKNOWN ? rhs : lhs;
+    }
+
+    // mismatched operands are an error the interpreter reports.
+    if (!is_value(lhs) || lhs != rhs) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    if (lhs == JIT_INT) {
+        EMIT(compiler, 0x48, 0x89, 0xc1); // mov rcx, rax
+        emit_load(compiler, JIT_INT, temp_offset(compiler, temp));
+        compile_int_binary(compiler, binary->type);
+        return JIT_INT;
+    }
+
+    EMIT(compiler, 0x66, 0x0f, 0x28, 0xc8); // movapd xmm1, xmm0
+    emit_load(compiler, JIT_FLOAT, temp_offset(compiler, temp));
+    return compile_float_binary(compiler, binary->type);
+}
+
+static JitType compile_call(JitCompiler* compiler, FunctionCall* funcall, bool tail) {
+    Module* module = compiler->jit->module;
+
+    int index = symbol_map_get(&module->fundecls_index, funcall->symbol);
+    if (funcall->symbol == SYM_PRINT || index < 0 || funcall->args_size > JIT_MAX_ARGS) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    FunctionDeclaration* fun = &module->fundecls[index];
+    if (fun->args_size != funcall->args_size) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    JitType args[JIT_MAX_ARGS];
+    bool known = true;
+
+    int base = compiler->temps;
+    for (int i = 0; i < funcall->args_size; i++) {
+        (void) push_temp(compiler);
+    }
+
+    for (int i = 0; i < funcall->args_size; i++) {
+        args[i] = compile_expression(compiler, funcall->args[i], false);
+        emit_store(compiler, args[i], temp_offset(compiler, base + i));
+
+        if (!is_value(args[i])) {
+            known = false;
+        }
+    }
+
+    compiler->temps = base;
+
+    if (!known) {
+        if (compiler->final) {
+            fail(compiler);
+        }
+        return JIT_UNKNOWN;
+    }
+
+    JitSpec* callee = find_spec(compiler->jit, fun, args);
+    if (!callee) {
+        if (compiler->final) {
+            fail(compiler);
+            return JIT_INT;
+        }
+
+        callee = spec_make(compiler->jit, fun, args);
+        unit_push(compiler, callee);
+        compiler->changed = true;
+    }
+
+    if (callee->state == SPEC_FAILED) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    if (tail && callee == compiler->spec) {
+        // a self tail call overwrites the arguments and jumps back to the top.
+        for (int i = 0; i < funcall->args_size; i++) {
+            emit_load(compiler, JIT_INT, temp_offset(compiler, base + i));
+            emit_store(compiler, JIT_INT, slot_offset(compiler, i));
+        }
+
+        EMIT(compiler, 0xe9); // jmp rel32
+        emit_u32(compiler, 0);
+        patch_rel32(compiler, compiler->code_size - 4, compiler->body_start);
+
+        return JIT_NONE;
+    }
+
+    // other calls grow the native stack, mutual tail recursion has to stay interpreted.
+    if (tail && callee->state != SPEC_COMPILED) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    for (int i = funcall->args_size - 1; i >= 0; i--) {
+        emit_load(compiler, JIT_INT, temp_offset(compiler, base + i));
+        EMIT(compiler, 0x50); // push rax
+    }
+
+    if (callee->state == SPEC_COMPILED) {
+        emit_mov_rax_imm(compiler, (uint64_t) (uintptr_t) callee->entry);
+        EMIT(compiler, 0xff, 0xd0); // call rax
+    } else {
+        EMIT(compiler, 0xe8); // call rel32
+        emit_u32(compiler, 0);
+        patch_push(compiler, compiler->code_size - 4, callee);
+    }
+
+    if (funcall->args_size > 0) {
+        EMIT(compiler, 0x48, 0x81, 0xc4); // add rsp, imm32
+        emit_u32(compiler, 8 * funcall->args_size);
+    }
+
+    if (compiler->final && callee->ret == JIT_UNKNOWN) {
+        fail(compiler);
+    }
+
+    return callee->ret;
+}
+
+static JitType compile_expression(JitCompiler* compiler, Expression* expression, bool tail) {
+    if (expression->type == EXPR_BINARY) {
+        return compile_binary(compiler, &expression->as.binary);
+    }
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_INT:
+            emit_mov_rax_imm(compiler, (uint64_t) value->as.integer);
+            return JIT_INT;
+        case VAL_FLOAT: {
+            uint64_t bits;
+            memcpy(&bits, &value->as.floating, sizeof(double));
+
+            emit_mov_rax_imm(compiler, bits);
+            EMIT(compiler, 0x66, 0x48, 0x0f, 0x6e, 0xc0); // movq xmm0, rax
+            return JIT_FLOAT;
+        }
+        case VAL_IDENT: {
+            int slot = value->as.identifier.slot;
+            JitType type = compiler->slot_types[slot];
+
+            if (type == JIT_CONFLICT || (compiler->final && type == JIT_UNKNOWN)) {
+                fail(compiler);
+                return JIT_INT;
+            }
+
+            emit_load(compiler, type, slot_offset(compiler, slot));
+            return type;
+        }
+        case VAL_FUNCALL:
+            return compile_call(compiler, &value->as.funcall, tail);
+        default:
+            // records need the heap, they stay interpreted.
+            fail(compiler);
+            return JIT_INT;
+    }
+}
+
+static void compile_let_block(JitCompiler* compiler, LetBlock* letblock) {
+    for (int i = 0; i < letblock->ids_size; i++) {
+        int slot = letblock->ids[i].slot;
+
+        EMIT(compiler, 0x48, 0xc7, 0x85); // mov qword [rbp + offset], 0
+        emit_u32(compiler, slot_offset(compiler, slot));
+        emit_u32(compiler, 0);
+
+        compiler->slot_types[slot] = JIT_INT;
+    }
+
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        Assignment* assignment = &letblock->assignments[i];
+
+        JitType type = compile_expression(compiler, assignment->expr, false);
+        emit_store(compiler, type, slot_offset(compiler, assignment->slot));
+
+        compiler->slot_types[assignment->slot] = type;
+    }
+}
+
+static JitType merge_types(JitType lhs, JitType rhs) {
+    if (lhs == rhs || rhs == JIT_UNKNOWN)
+        return lhs;
+    if (lhs == JIT_UNKNOWN)
+        return rhs;
+
+    return JIT_CONFLICT;
+}
+
+static JitType compile_if_statement(JitCompiler* compiler, IfStatement* ifstatement, bool tail) {
+    JitType condition = compile_expression(compiler, ifstatement->expr, false);
+
+    // a float condition is an error the interpreter reports.
+    if (condition != JIT_INT && (condition != JIT_UNKNOWN || compiler->final)) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    int slots_size = compiler->spec->fundecl->slots_size;
+    JitType* before = jit_realloc(NULL, sizeof(JitType) * (slots_size + 1));
+    JitType* after_true = jit_realloc(NULL, sizeof(JitType) * (slots_size + 1));
+    memcpy(before, compiler->slot_types, sizeof(JitType) * slots_size);
+
+    EMIT(compiler, 0x48, 0x85, 0xc0); // test rax, rax
+    EMIT(compiler, 0x0f, 0x84); // jz rel32
+    emit_u32(compiler, 0);
+    size_t to_false = compiler->code_size - 4;
+
+    JitType true_type = compile_block(compiler, ifstatement->true_block, tail);
+    memcpy(after_true, compiler->slot_types, sizeof(JitType) * slots_size);
+    memcpy(compiler->slot_types, before, sizeof(JitType) * slots_size);
+
+    EMIT(compiler, 0xe9); // jmp rel32
+    emit_u32(compiler, 0);
+    size_t to_end = compiler->code_size - 4;
+
+    patch_rel32(compiler, to_false, compiler->code_size);
+
+    JitType false_type = compile_block(compiler, ifstatement->false_block, tail);
+
+    patch_rel32(compiler, to_end, compiler->code_size);
+
+    // a branch that jumps away leaves the slots as the other one does.
+    if (false_type == JIT_NONE) {
+        memcpy(compiler->slot_types, after_true, sizeof(JitType) * slots_size);
+    } else if (true_type != JIT_NONE) {
+        for (int i = 0; i < slots_size; i++) {
+            compiler->slot_types[i] = merge_types(after_true[i], compiler->slot_types[i]);
+        }
+    }
+
+    free(before);
+    free(after_true);
+
+    if (true_type == JIT_NONE)
+        return false_type;
+    if (false_type == JIT_NONE)
+        return true_type;
+
+    JitType type = merge_types(true_type, false_type);
+    if (type == JIT_CONFLICT) {
+        fail(compiler);
+        return JIT_INT;
+    }
+
+    return type;
+}
+
+static JitType compile_block(JitCompiler* compiler, Block* block, bool tail) {
+    for (int i = 0; i < block->children_size; i++) {
+        Statement* statement = &block->children[i];
+        bool last = i == block->children_size - 1;
+
+        switch (statement->type) {
+            case STMT_LETBLOCK:
+                compile_let_block(compiler, &statement->as.letblock);
+                if (last) {
+                    fail(compiler);
+                    return JIT_INT;
+                }
+                break;
+            case STMT_IF: {
+                JitType type = compile_if_statement(compiler, &statement->as.ifstatement, tail && last);
+                if (last) {
+                    return type;
+                }
+                break;
+            }
+            case STMT_EXPRESSION: {
+                JitType type = compile_expression(compiler, statement->as.expression, tail && last);
+                if (last) {
+                    return type;
+                }
+                break;
+            }
+        }
+    }
+
+    fail(compiler);
+    return JIT_INT;
+}
+
+static void compile_spec(JitCompiler* compiler, JitSpec* spec) {
+    FunctionDeclaration* fundecl = spec->fundecl;
+
+    compiler->spec = spec;
+
+    if (fundecl->slots_size >= compiler->slot_types_cap) {
+        compiler->slot_types_cap = fundecl->slots_size + 1;
+        compiler->slot_types = jit_realloc(compiler->slot_types, sizeof(JitType) * compiler->slot_types_cap);
+    }
+
+    for (int i = 0; i < fundecl->slots_size; i++) {
+        compiler->slot_types[i] = i < fundecl->args_size ? spec->args[i] : JIT_INT;
+    }
+
+    compiler->lets = fundecl->slots_size - fundecl->args_size;
+    compiler->temps = 0;
+    compiler->temps_max = 0;
+
+    spec->offset = compiler->code_size;
+
+    EMIT(compiler, 0x55);             // push rbp
+    EMIT(compiler, 0x48, 0x89, 0xe5); // mov rbp, rsp
+    EMIT(compiler, 0x48, 0x81, 0xec); // sub rsp, imm32
+    emit_u32(compiler, 0);
+    size_t frame_size = compiler->code_size - 4;
+
+    compiler->body_start = compiler->code_size;
+
+    JitType type = compile_block(compiler, fundecl->block, true);
+
+    if (is_value(type) && spec->ret == JIT_UNKNOWN && !compiler->final) {
+        spec->ret = type;
+        compiler->changed = true;
+    } else if (type != JIT_NONE && type != JIT_UNKNOWN && type != spec->ret) {
+        fail(compiler);
+    } else if (compiler->final && !is_value(spec->ret)) {
+        fail(compiler);
+    }
+
+    EMIT(compiler, 0xc9, 0xc3); // leave; ret
+
+    int slots = compiler->lets + compiler->temps_max;
+    patch_u32(compiler, frame_size, (uint32_t) ((8 * slots + 15) & ~15));
+}
+
+// the C entry point, takes the arguments as an array of raw ints / doubles.
+static void compile_enter(JitCompiler* compiler, JitSpec* spec) {
+    spec->enter_offset = compiler->code_size;
+
+    EMIT(compiler, 0x55);             // push rbp
+    EMIT(compiler, 0x48, 0x89, 0xe5); // mov rbp, rsp
+
+    for (int i = spec->fundecl->args_size - 1; i >= 0; i--) {
+        EMIT(compiler, 0x48, 0x8b, 0x87); // mov rax, [rdi + offset]
+        emit_u32(compiler, 8 * i);
+        EMIT(compiler, 0x50);             // push rax
+    }
+
+    EMIT(compiler, 0xe8); // call rel32
+    emit_u32(compiler, 0);
+    patch_rel32(compiler, compiler->code_size - 4, spec->offset);
+
+    if (spec->ret == JIT_FLOAT) {
+        EMIT(compiler, 0x66, 0x48, 0x0f, 0x7e, 0xc0); // movq rax, xmm0
+    }
+
+    EMIT(compiler, 0xc9, 0xc3); // leave; ret
+}
+
+static void jit_compile(Jit* jit, JitSpec* root) {
+    JitCompiler compiler = {
+        .jit = jit,
+    };
+
+    unit_push(&compiler, root);
+
+    // every pass can discover callees and learn return types, stop once nothing changes.
+    for (int pass = 0; !compiler.failed; pass++) {
+        compiler.changed = false;
+
+        for (int i = 0; i < compiler.unit_size && !compiler.failed; i++) {
+            compiler.code_size = 0;
+            compiler.patches_size = 0;
+            compile_spec(&compiler, compiler.unit[i]);
+        }
+
+        if (!compiler.changed)
+            break;
+
+        if (pass > 2 * compiler.unit_size + 4) {
+            fail(&compiler);
+        }
+    }
+
+    if (!compiler.failed) {
+        compiler.final = true;
+        compiler.code_size = 0;
+        compiler.patches_size = 0;
+
+        for (int i = 0; i < compiler.unit_size && !compiler.failed; i++) {
+            compile_spec(&compiler, compiler.unit[i]);
+        }
+
+        for (int i = 0; i < compiler.unit_size && !compiler.failed; i++) {
+            compile_enter(&compiler, compiler.unit[i]);
+        }
+    }
+
+    uint8_t* code = NULL;
+    if (!compiler.failed) {
+        for (int i = 0; i < compiler.patches_size; i++) {
+            patch_rel32(&compiler, compiler.patches[i].at, compiler.patches[i].target->offset);
+        }
+
+        code = mmap(NULL, compiler.code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            code = NULL;
+        } else {
+            memcpy(code, compiler.code, compiler.code_size);
+
+            if (mprotect(code, compiler.code_size, PROT_READ | PROT_EXEC) != 0) {
+                munmap(code, compiler.code_size);
+                code = NULL;
+            }
+        }
+    }
+
+    if (code) {
+        JitRegion* region = jit_realloc(NULL, sizeof(JitRegion));
+        region->next = jit->regions;
+        region->code = code;
+        region->size = compiler.code_size;
+        jit->regions = region;
+
+        for (int i = 0; i < compiler.unit_size; i++) {
+            JitSpec* spec = compiler.unit[i];
+
+            spec->state = SPEC_COMPILED;
+            spec->entry = code + spec->offset;
+            spec->enter = (uint64_t (*)(const uint64_t*)) (void*) (code + spec->enter_offset);
+        }
+
+        jit->stats.compilations += compiler.unit_size;
+        jit->stats.code_bytes += compiler.code_size;
+    } else {
+        // callees found on the way may still be fine on their own once they get hot.
+        for (int i = 1; i < compiler.unit_size; i++) {
+            spec_free(jit, compiler.unit[i]);
+        }
+
+        root->state = SPEC_FAILED;
+        jit->stats.failures++;
+    }
+
+    free(compiler.unit);
+    free(compiler.code);
+    free(compiler.patches);
+    free(compiler.slot_types);
+}
+
+void jit_init(Jit* jit, Module* module, int threshold) {
+    assert(jit != NULL);
+    assert(module != NULL);
+
+    jit->module = module;
+    jit->threshold = threshold;
+
+    int size = module->fundecls_size ? module->fundecls_size : 1;
+    jit->calls = jit_realloc(NULL, sizeof(int) * size);
+    jit->specs = jit_realloc(NULL, sizeof(JitSpec*) * size);
+
+    for (int i = 0; i < size; i++) {
+        jit->calls[i] = 0;
+        jit->specs[i] = NULL;
+    }
+
+    jit->regions = NULL;
+
+    jit->stats = (JitStats) {0};
+}
+
+void jit_deinit(Jit* jit) {
+    assert(jit != NULL);
+
+    for (int i = 0; i < jit->module->fundecls_size; i++) {
+        JitSpec* spec = jit->specs[i];
+        while (spec) {
+            JitSpec* next = spec->next;
+            free(spec);
+            spec = next;
+        }
+    }
+
+    JitRegion* region = jit->regions;
+    while (region) {
+        JitRegion* next = region->next;
+        munmap(region->code, region->size);
+        free(region);
+        region = next;
+    }
+
+    free(jit->calls);
+    free(jit->specs);
+}
+
+bool jit_call(Jit* jit, Heap* heap, FunctionDeclaration* fundecl, Object* args, Object* result) {
+    if (fundecl->args_size > JIT_MAX_ARGS)
+        return false;
+
+    JitType types[JIT_MAX_ARGS];
+    uint64_t raw[JIT_MAX_ARGS];
+
+    for (int i = 0; i < fundecl->args_size; i++) {
+        if (object_is_small_int(args[i])) {
+            types[i] = JIT_INT;
+            raw[i] = (uint64_t) object_as_small_int(args[i]);
+        } else if (object_is_float(args[i])) {
+            types[i] = JIT_FLOAT;
+            raw[i] = args[i].bits;
+        } else {
+            return false;
+        }
+    }
+
+    JitSpec* spec = find_spec(jit, fundecl, types);
+    if (!spec) {
+        int* calls = &jit->calls[fundecl - jit->module->fundecls];
+        if (++*calls < jit->threshold)
+            return false;
+
+        spec = spec_make(jit, fundecl, types);
+        jit_compile(jit, spec);
+    }
+
+    if (spec->state != SPEC_COMPILED)
+        return false;
+
+    uint64_t bits = spec->enter(raw);
+    jit->stats.native_calls++;
+
+    if (spec->ret == JIT_INT) {
+        *result = heap_make_int(heap, (int64_t) bits);
+    } else {
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        *result = object_float(value);
+    }
+
+    return true;
+}
+
+#else
+
+void jit_init(Jit* jit, Module* module, int threshold) {
+    assert(jit != NULL);
+
+    *jit = (Jit) {
+        .module = module,
+        .threshold = threshold,
+    };
+}
+
+void jit_deinit(Jit* jit) {
+    (void) jit;
+}
+
+bool jit_call(Jit* jit, Heap* heap, FunctionDeclaration* fundecl, Object* args, Object* result) {
+    (void) jit;
+    (void) heap;
+    (void) fundecl;
+    (void) args;
+    (void) result;
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ast.h"
+#include "gc.h"
+#include "object.h"
+
+typedef struct JitSpec_t JitSpec;
+typedef struct JitRegion_t JitRegion;
+
+typedef struct {
+    long compilations; // specializations turned into native code
+    long failures;     // specializations left to the interpreter
+    long native_calls; // calls from the interpreter into native code
+
+    size_t code_bytes;
+} JitStats;
+
+// baseline compiler for numeric functions, only available on x86-64 linux.
+// a function is compiled once it has been called threshold times, specialized
+// for the int / float types of the arguments it was called with.
+typedef struct {
+    Module* module;
+    int threshold;
+
+    // both per function declaration.
+    int* calls;
+    JitSpec** specs; // one per argument type signature tried so far
+
+    JitRegion* regions; // executable memory
+
+    JitStats stats;
+} Jit;
+
+#define JIT_DEFAULT_THRESHOLD 100
+
+void jit_init(Jit* jit, Module* module, int threshold);
+void jit_deinit(Jit* jit);
+
+// runs fundecl natively if it is, or just became, compiled for these arguments.
+// returns false when the call has to be interpreted.
+bool jit_call(Jit* jit, Heap* heap, FunctionDeclaration* fundecl, Object* args, Object* result);
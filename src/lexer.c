@@ -1,346 +1,575 @@
 #include <assert.h>
-#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "lexer.h"
 
-typedef struct {
-    Token* tokens;
-    int tokens_size;
-    int tokens_cap;
-} Tokens;
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-static void tokens_init(Tokens* tokens) {
-    assert(tokens != NULL);
+static char peek(Lexer* lexer) {
+    return lexer->source < lexer->end ? *lexer->source : 0;
+}
+
+static void advance(Lexer* lexer) {
+    lexer->source++;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || (unsigned char) (c - '\t') <= '\r' - '\t';
+}
+
+static bool is_digit(char c) {
+    return (unsigned char) (c - '0') <= 9;
+}
+
+static bool is_word_start(char c) {
+    return (unsigned char) ((c | 0x20) - 'a') <= 'z' - 'a' || c == '_';
+}
+
+static bool is_word(char c) {
+    return is_word_start(c) || is_digit(c);
+}
+
+// runs of whitespace, identifier and digit characters are classified a block of
+// bytes at a time, one mask bit per byte. a scalar loop finishes the last bytes.
+#if defined(__AVX2__)
+#define BLOCK_SIZE 32
+
+typedef __m256i Block;
+typedef uint32_t BlockMask;
+
+static inline Block block_load(const char* p) { return _mm256_loadu_si256((const __m256i*) p); }
+static inline Block block_set(char c) { return _mm256_set1_epi8(c); }
+static inline Block block_eq(Block a, Block b) { return _mm256_cmpeq_epi8(a, b); }
+static inline Block block_or(Block a, Block b) { return _mm256_or_si256(a, b); }
+static inline Block block_sub(Block a, Block b) { return _mm256_sub_epi8(a, b); }
+static inline Block block_min(Block a, Block b) { return _mm256_min_epu8(a, b); }
+static inline BlockMask block_mask(Block a) { return (uint32_t) _mm256_movemask_epi8(a); }
+#elif defined(__SSE2__)
+#define BLOCK_SIZE 16
+
+typedef __m128i Block;
+typedef uint32_t BlockMask;
+
+static inline Block block_load(const char* p) { return _mm_loadu_si128((const __m128i*) p); }
+static inline Block block_set(char c) { return _mm_set1_epi8(c); }
+static inline Block block_eq(Block a, Block b) { return _mm_cmpeq_epi8(a, b); }
+static inline Block block_or(Block a, Block b) { return _mm_or_si128(a, b); }
+static inline Block block_sub(Block a, Block b) { return _mm_sub_epi8(a, b); }
+static inline Block block_min(Block a, Block b) { return _mm_min_epu8(a, b); }
+static inline BlockMask block_mask(Block a) { return (uint32_t) _mm_movemask_epi8(a); }
+#endif
+
+#ifdef BLOCK_SIZE
+#define BLOCK_ALL ((BlockMask) (((uint64_t) 1 << BLOCK_SIZE) - 1))
+
+// bytes from lo to lo + width, compared unsigned.
+static inline Block block_range(Block v, char lo, char width) {
+    Block offset = block_sub(v, block_set(lo));
+    return block_eq(block_min(offset, block_set(width)), offset);
+}
+
+static inline BlockMask block_spaces(Block v) {
+    return block_mask(block_or(block_eq(v, block_set(' ')), block_range(v, '\t', '\r' - '\t')));
+}
+
+static inline BlockMask block_digits(Block v) {
+    return block_mask(block_range(v, '0', 9));
+}
+
+static inline BlockMask block_words(Block v) {
+    Block letters = block_range(block_or(v, block_set(0x20)), 'a', 'z' - 'a');
+    Block underscores = block_eq(v, block_set('_'));
+
+    return block_mask(block_or(block_or(letters, underscores), block_range(v, '0', 9)));
+}
+#endif
+
+static const char* scan_digits(const char* p, const char* end) {
+#ifdef BLOCK_SIZE
+    while (end - p >= BLOCK_SIZE) {
+        BlockMask stop = ~block_digits(block_load(p)) & BLOCK_ALL;
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+
+        p += BLOCK_SIZE;
+    }
+#endif
+
+    while (p < end && is_digit(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+static const char* scan_word(const char* p, const char* end) {
+#ifdef BLOCK_SIZE
+    while (end - p >= BLOCK_SIZE) {
+        BlockMask stop = ~block_words(block_load(p)) & BLOCK_ALL;
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+
+        p += BLOCK_SIZE;
+    }
+#endif
+
+    while (p < end && is_word(*p)) {
+        p++;
+    }
 
-    tokens->tokens = NULL;
-    tokens->tokens_size = 0;
-    tokens->tokens_cap = 0;
+    return p;
 }
 
-static void tokens_push(Tokens* tokens, Token token) {
-    if (!tokens->tokens) {
-        tokens->tokens_cap = 1;
-        tokens->tokens = malloc(sizeof(Token));
+static const char* scan_spaces(const char* p, const char* end) {
+    // most runs are a single blank between tokens, not worth a block. p may be
+    // on a comment instead, which is not skipped here.
+    if (p + 1 < end && is_space(*p) && !is_space(p[1])) {
+        return p + 1;
+    }
 
-        assert(tokens->tokens != NULL);
-    } else {
-        tokens->tokens_cap++;
-        tokens->tokens = realloc(tokens->tokens, sizeof(Token) * tokens->tokens_cap);
+#ifdef BLOCK_SIZE
+    while (end - p >= BLOCK_SIZE) {
+        BlockMask stop = ~block_spaces(block_load(p)) & BLOCK_ALL;
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
 
-        assert(tokens->tokens != NULL);
+        p += BLOCK_SIZE;
     }
+#endif
 
-    tokens->tokens[tokens->tokens_size++] = token;
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+
+    return p;
 }
 
-static const char* s_source = NULL;
-static int s_line = 1;
-static int s_col = 1;
-static bool s_init = false;
-
-static void advance() {
-    if (*s_source == '\n') {
-        s_line++;
-        s_col = 1;
-    } else {
-        s_col++;
+// up to the line end closing the comment, or the end of the source.
+static const char* scan_comment(const char* p, const char* end) {
+    const char* newline = memchr(p, '\n', end - p);
+    return newline ? newline : end;
+}
+
+typedef struct {
+    const char* text;
+    int size;
+    TokenType type;
+    Symbol symbol;
+} Keyword;
+
+// perfect hash on the first character, every keyword lands in a slot of its own.
+#define KEYWORD_HASH(c) ((c) & 15)
+
+static const Keyword s_keywords[16] = {
+    [KEYWORD_HASH('r')] = {"record", 6, TOK_RECORD, SYM_RECORD},
+    [KEYWORD_HASH('d')] = {"def", 3, TOK_DEF, SYM_DEF},
+    [KEYWORD_HASH('l')] = {"let", 3, TOK_LET, SYM_LET},
+    [KEYWORD_HASH('i')] = {"if", 2, TOK_IF, SYM_IF},
+    [KEYWORD_HASH('e')] = {"else", 4, TOK_ELSE, SYM_ELSE},
+};
+
+static const Keyword* find_keyword(Span span) {
+    const Keyword* keyword = &s_keywords[KEYWORD_HASH(span.data[0])];
+
+    if (keyword->size == span.size && memcmp(keyword->text, span.data, span.size) == 0) {
+        return keyword;
     }
 
-    s_source++;
+    return NULL;
+}
+
+static void fail(Lexer* lexer, const char* error, Span span) {
+    lexer->error = error;
+    lexer->error_span = span;
 }
 
-void lexer_init(const char* source) {
+NORETURN static void die(Lexer* lexer, Tokens* tokens) {
+    int line, col;
+    tokens_position(tokens, lexer->error_span.data, &line, &col);
+
+    error_and_die("[%d:%d] %s: "SPAN_FMT, line, col, lexer->error, SPAN_ARG(lexer->error_span));
+}
+
+
+static void lexer_init_range(Lexer* lexer, const char* source, const char* end) {
+    lexer->start = source;
+    lexer->source = source;
+    lexer->end = end;
+
+    lexer->intern = true;
+
+    lexer->error = NULL;
+    lexer->error_span = span_make(source, 0);
+}
+
+void lexer_init(Lexer* lexer, const char* source, size_t size) {
+    assert(lexer != NULL);
     assert(source != NULL);
 
-    s_source = source;
-    s_line = 1;
-    s_col = 1;
+    // lexing stops at a zero byte, past it the scanners never have to look for one.
+    const char* zero = memchr(source, 0, size);
 
-    s_init = true;
+    lexer_init_range(lexer, source, zero ? zero : source + size);
 }
 
-Token* lexer_lex(int* size) {
-    assert(s_init);
+// an integer or floating point literal starting at start, the sign if any is
+// already consumed.
+static bool lex_number(Lexer* lexer, Tokens* tokens, const char* start) {
+    lexer->source = scan_digits(lexer->source, lexer->end);
 
-    Tokens tokens;
-    int tokens_size = 0;
+    if (peek(lexer) != '.') {
+        tokens_push(tokens, TOK_INTLITERAL, start, lexer->source - start, SYMBOL_NONE);
+        return true;
+    }
 
-    tokens_init(&tokens);
+    advance(lexer);
 
-    while (*s_source) {
-        while (*s_source && (isspace(*s_source) || *s_source == '#')) {
-            while (*s_source && isspace(*s_source)) {
-                advance();
-            }
+    const char* mantissa = lexer->source;
+    lexer->source = scan_digits(lexer->source, lexer->end);
+
+    if (lexer->source == mantissa) {
+        fail(lexer, "invalid floating point number", span_make(start, lexer->source - start));
+        return false;
+    }
+
+    tokens_push(tokens, TOK_FLOATLITERAL, start, lexer->source - start, SYMBOL_NONE);
+
+    return true;
+}
+
+// lexes until there are limit tokens, the end of the source or the first error.
+static void lex_tokens(Lexer* lexer, Tokens* tokens, int limit) {
+    while (tokens->size < limit && peek(lexer)) {
+        while (is_space(peek(lexer)) || peek(lexer) == '#') {
+            lexer->source = scan_spaces(lexer->source, lexer->end);
 
-            if (*s_source && *s_source == '#') {
-                do {
-                    advance();
-                } while (*s_source && *s_source != '\n');
+            if (peek(lexer) == '#') {
+                lexer->source = scan_comment(lexer->source, lexer->end);
             }
         }
 
-        const char* start = s_source;
-        int start_line = s_line;
-        int start_col = s_col;
+        const char* start = lexer->source;
 
-        if (!*s_source) {
+        if (!peek(lexer)) {
             break;
         }
 
-        switch (*s_source) {
+        switch (peek(lexer)) {
             case '(':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_LPAREN, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_LPAREN, start, 1, SYMBOL_NONE);
                 continue;
             case ')':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_RPAREN, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_RPAREN, start, 1, SYMBOL_NONE);
                 continue;
             case '[':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_LSBRACE, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_LSBRACE, start, 1, SYMBOL_NONE);
                 continue;
             case ']':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_RSBRACE, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_RSBRACE, start, 1, SYMBOL_NONE);
                 continue;
             case '{':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_LCBRACE, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_LCBRACE, start, 1, SYMBOL_NONE);
                 continue;
             case '}':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_RCBRACE, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_RCBRACE, start, 1, SYMBOL_NONE);
                 continue;
             case ',':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_COMMA, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_COMMA, start, 1, SYMBOL_NONE);
                 continue;
             case '=':
-                advance();
+                advance(lexer);
 
-                if (*s_source == '=') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_EQUALEQUAL, span_make(start, 1)));
-                    tokens_size++;
+                if (peek(lexer) == '=') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_EQUALEQUAL, start, 1, SYMBOL_NONE);
                 } else {
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_EQUAL, span_make(start, 1)));
-                    tokens_size++;
+                    tokens_push(tokens, TOK_EQUAL, start, 1, SYMBOL_NONE);
                 }
                 continue;
             case '!':
-                advance();
+                advance(lexer);
 
-                if (*s_source == '=') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_NOTEQUAL, span_make(start, 1)));
-                    tokens_size++;
+                if (peek(lexer) == '=') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_NOTEQUAL, start, 1, SYMBOL_NONE);
                 } else {
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_BANG, span_make(start, 1)));
-                    tokens_size++;
+                    tokens_push(tokens, TOK_BANG, start, 1, SYMBOL_NONE);
                 }
 
                 continue;
             case '+':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_PLUS, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_PLUS, start, 1, SYMBOL_NONE);
                 continue;
             case '-': {
-                advance();
-
-                if (isdigit(*s_source)) {
-                    int len = 0;
-                    do {
-                        len++;
-                        advance();
-                    } while (*s_source && isdigit(*s_source));
-
-                    if (*s_source == '.') {
-                        len++;
-                        advance();
-
-                        int mantissa_len = 0;
-                        do {
-                            mantissa_len++;
-                            advance();
-                        } while (*s_source && isdigit(*s_source));
-
-                        Span span = span_make(start, len + mantissa_len);
-
-                        if (mantissa_len == 0) {
-                            error_and_die("invalid floating point number: "SPAN_FMT, SPAN_ARG(span));
-                        }
-
-                        tokens_push(&tokens, token_make(start_line, start_col, TOK_FLOATLITERAL, span));
-                        tokens_size++;
-                    } else {
-                        tokens_push(&tokens, token_make(start_line, start_col, TOK_INTLITERAL, span_make(start, len)));
-                        tokens_size++;
+                advance(lexer);
+
+                if (is_digit(peek(lexer))) {
+                    if (!lex_number(lexer, tokens, start)) {
+                        return;
                     }
-                } else if (*s_source == '>') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_ARROW, span_make(start, 2)));
-                    tokens_size++;
+                } else if (peek(lexer) == '>') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_ARROW, start, 2, SYMBOL_NONE);
                 } else {
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_MINUS, span_make(start, 1)));
-                    tokens_size++;
+                    tokens_push(tokens, TOK_MINUS, start, 1, SYMBOL_NONE);
                 }
 
                 continue;
             }
             case '*':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_STAR, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_STAR, start, 1, SYMBOL_NONE);
                 continue;
             case '/':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_SLASH, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_SLASH, start, 1, SYMBOL_NONE);
                 continue;
             case '<':
-                advance();
-                if (*s_source == '=') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_LESSEQUAL, span_make(start, 2)));
-                    tokens_size++;
+                advance(lexer);
+                if (peek(lexer) == '=') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_LESSEQUAL, start, 2, SYMBOL_NONE);
                 } else {
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_LESS, span_make(start, 2)));
-                    tokens_size++;
+                    tokens_push(tokens, TOK_LESS, start, 2, SYMBOL_NONE);
                 }
                 continue;
             case '>':
-                advance();
+                advance(lexer);
 
-                if (*s_source == '=') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_GREATEREQUAL, span_make(start, 2)));
-                    tokens_size++;
+                if (peek(lexer) == '=') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_GREATEREQUAL, start, 2, SYMBOL_NONE);
                 } else {
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_GREATER, span_make(start, 2)));
-                    tokens_size++;
+                    tokens_push(tokens, TOK_GREATER, start, 2, SYMBOL_NONE);
                 }
 
                 continue;
 
             case '&':
-                advance(); 
+                advance(lexer);
 
-                if (*s_source == '&') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_ANDAND, span_make(start, 2)));
-                    tokens_size++;
+                if (peek(lexer) == '&') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_ANDAND, start, 2, SYMBOL_NONE);
                 } else {
-                    error_and_die("invalid token: &");
+                    fail(lexer, "invalid token", span_make(start, 1));
+                    return;
                 }
 
                 continue;
             case '|':
-                advance(); 
+                advance(lexer);
 
-                if (*s_source == '|') {
-                    advance();
-                    tokens_push(&tokens, token_make(start_line, start_col, TOK_BARBAR, span_make(start, 2)));
-                    tokens_size++;
+                if (peek(lexer) == '|') {
+                    advance(lexer);
+                    tokens_push(tokens, TOK_BARBAR, start, 2, SYMBOL_NONE);
                 } else {
-                    error_and_die("invalid token: |");
+                    fail(lexer, "invalid token", span_make(start, 1));
+                    return;
                 }
 
                 continue;
             case '.':
-                advance();
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_DOT, span_make(start, 1)));
-                tokens_size++;
+                advance(lexer);
+                tokens_push(tokens, TOK_DOT, start, 1, SYMBOL_NONE);
                 continue;
             default:
                 break;
         }
 
-        if (isdigit(*s_source)) {
-            int len = 0;
-            do {
-                len++;
-                advance();
-            } while (*s_source && isdigit(*s_source));
-
-            if (*s_source == '.') {
-                len++;
-                advance();
-
-                int mantissa_len = 0;
-                do {
-                    mantissa_len++;
-                    advance();
-                } while (*s_source && isdigit(*s_source));
-
-                Span span = span_make(start, len + mantissa_len);
+        if (is_digit(peek(lexer))) {
+            if (!lex_number(lexer, tokens, start)) {
+                return;
+            }
+        } else if (is_word_start(peek(lexer))) {
+            lexer->source = scan_word(lexer->source + 1, lexer->end);
 
-                if (mantissa_len == 0) {
-                    error_and_die("invalid floating point number: "SPAN_FMT, SPAN_ARG(span));
-                }
+            Span span = span_make(start, lexer->source - start);
+            const Keyword* keyword = find_keyword(span);
 
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_FLOATLITERAL, span));
-                tokens_size++;
+            if (keyword) {
+                tokens_push(tokens, keyword->type, start, span.size, keyword->symbol);
             } else {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_INTLITERAL, span_make(start, len)));
-                tokens_size++;
+                tokens_push(tokens, TOK_IDENTIFIER, start, span.size, lexer->intern ? symbol_intern(span) : SYMBOL_NONE);
             }
-        } else if (isalpha(*s_source) || *s_source == '_') {
+        } else {
             int len = 0;
             do {
                 len++;
-                advance();
-            } while (*s_source && (isalnum(*s_source) || *s_source == '_'));
+                advance(lexer);
+            } while (peek(lexer) && !is_space(peek(lexer)));
 
             Span span = span_make(start, len);
 
-            if(span_equals(span, span_from_cstr("record"))) {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_RECORD, span_make(start, len)));
-                tokens_size++;
-            } else if (span_equals(span, span_from_cstr("def"))) {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_DEF, span_make(start, len)));
-                tokens_size++;
-            } else if (span_equals(span, span_from_cstr("let"))) {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_LET, span_make(start, len)));
-                tokens_size++;
-            } else if (span_equals(span, span_from_cstr("if"))) {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_IF, span_make(start, len)));
-                tokens_size++;
-            } else if (span_equals(span, span_from_cstr("else"))) {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_ELSE, span_make(start, len)));
-                tokens_size++;
-            } else {
-                tokens_push(&tokens, token_make(start_line, start_col, TOK_IDENTIFIER, span_make(start, len)));
-                tokens_size++;
+            fail(lexer, "found garbage token", span);
+            return;
+        }
+    }
+}
+
+void lexer_lex(Lexer* lexer, Tokens* tokens) {
+    assert(lexer != NULL);
+    assert(tokens != NULL);
+
+    tokens_init(tokens, lexer->start, lexer->end - lexer->start);
+
+    lex_tokens(lexer, tokens, INT_MAX);
+
+    if (lexer->error) {
+        die(lexer, tokens);
+    }
+}
+
+void lexer_fill(Lexer* lexer, Tokens* tokens) {
+    assert(lexer != NULL);
+    assert(tokens != NULL);
+    assert(tokens->source == lexer->start);
+
+    // the tokens before an error are handed out first, so errors come in source order.
+    if (!lexer->error) {
+        lex_tokens(lexer, tokens, tokens->cap);
+    }
+
+    if (lexer->error && tokens->size == 0) {
+        die(lexer, tokens);
+    }
+}
+
+typedef struct {
+    Lexer lexer;
+    Tokens tokens;
+    pthread_t thread;
+} LexerChunk;
+
+static void* lex_chunk(void* data) {
+    LexerChunk* chunk = data;
+    lex_tokens(&chunk->lexer, &chunk->tokens, INT_MAX);
+    return NULL;
+}
+
+void lexer_lex_parallel(const char* source, size_t source_size, int threads, Tokens* tokens) {
+    assert(source != NULL);
+    assert(threads > 0);
+    assert(tokens != NULL);
+
+    Lexer lexer;
+    lexer_init(&lexer, source, source_size);
+
+    source_size = lexer.end - source;
+    size_t chunks_max = source_size / LEXER_CHUNK_MIN;
+
+    if (threads < 2 || chunks_max < 2) {
+        lexer_lex(&lexer, tokens);
+        return;
+    }
+
+    if ((size_t) threads > chunks_max) {
+        threads = chunks_max;
+    }
+
+    LexerChunk* chunks = malloc(sizeof(LexerChunk) * threads);
+    if (!chunks) {
+        error_and_die("cannot allocate memory");
+    }
+
+    // no token spans a line end, so every chunk but the last ends just after one.
+    const char* end = source + source_size;
+    const char* start = source;
+    int chunks_size = 0;
+
+    while (start < end && chunks_size < threads) {
+        const char* stop = end;
+
+        if (chunks_size < threads - 1) {
+            const char* target = source + source_size / threads * (chunks_size + 1);
+            if (target < start) {
+                target = start;
             }
-        } else {
-            int len = 0;
-            do {
-                len++;
-                advance();
-            } while (*s_source && !isspace(*s_source));
 
-            Span span = span_make(start, len);
+            const char* newline = memchr(target, '\n', end - target);
+            stop = newline ? newline + 1 : end;
+        }
+
+        LexerChunk* chunk = &chunks[chunks_size++];
+
+        lexer_init_range(&chunk->lexer, start, stop);
+        chunk->lexer.intern = false;
 
-            fprintf(stderr, "[%d:%d] ", start_line, start_col);
-            error_and_die("found garbage token: "SPAN_FMT, SPAN_ARG(span));
+        // offsets are taken from the start of the whole source, not the chunk.
+        tokens_init(&chunk->tokens, source, source_size);
+
+        start = stop;
+    }
+
+    for (int i = 1; i < chunks_size; i++) {
+        if (pthread_create(&chunks[i].thread, NULL, lex_chunk, &chunks[i]) != 0) {
+            error_and_die("cannot start thread");
         }
     }
 
-    *size = tokens_size;
+    lex_chunk(&chunks[0]);
+
+    for (int i = 1; i < chunks_size; i++) {
+        pthread_join(chunks[i].thread, NULL);
+    }
+
+    tokens_init(tokens, source, source_size);
+
+    int tokens_size = 0;
+    for (int i = 0; i < chunks_size; i++) {
+        tokens_size += chunks[i].tokens.size;
+    }
+
+    tokens_grow(tokens, tokens_size ? tokens_size : 1);
+
+    // interning in source order hands out the same symbols as lexing in one go.
+    for (int i = 0; i < chunks_size; i++) {
+        LexerChunk* chunk = &chunks[i];
+
+        if (chunk->lexer.error) {
+            die(&chunk->lexer, tokens);
+        }
+
+        int base = tokens->size;
+        int size = chunk->tokens.size;
+
+        memcpy(&tokens->types[base], chunk->tokens.types, sizeof(uint8_t) * size);
+        memcpy(&tokens->offsets[base], chunk->tokens.offsets, sizeof(uint32_t) * size);
+        memcpy(&tokens->sizes[base], chunk->tokens.sizes, sizeof(uint32_t) * size);
+        memcpy(&tokens->symbols[base], chunk->tokens.symbols, sizeof(Symbol) * size);
+
+        tokens->size += size;
+
+        for (int j = base; j < tokens->size; j++) {
+            if (tokens->types[j] == TOK_IDENTIFIER) {
+                tokens->symbols[j] = symbol_intern(tokens_get(tokens, j).span);
+            }
+        }
+
+        tokens_free(&chunk->tokens);
+    }
 
-    return tokens.tokens;
+    free(chunks);
 }
@@ -1,7 +1,39 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "token.h"
 
-void lexer_init(const char* source);
+// lexing state for one source buffer, any number of them can run at once.
+typedef struct {
+    const char* start;
+    const char* source;
+    const char* end;
+
+    // identifiers are interned as they are found, chunks lexed on other threads
+    // leave that to the stitching since the symbol table is not shared.
+    bool intern;
+
+    // the first invalid token, lexing stops there.
+    const char* error;
+    Span error_span;
+} Lexer;
+
+// sources are split into chunks of at least this many bytes for parallel lexing.
+#define LEXER_CHUNK_MIN (256 * 1024)
+
+// the source needs no terminating zero, lexing stops after size bytes or at a zero byte.
+void lexer_init(Lexer* lexer, const char* source, size_t size);
+
+// fills tokens, which is initialized here and released with tokens_free.
+void lexer_lex(Lexer* lexer, Tokens* tokens);
+
+// adds tokens until tokens is full or the source ends, for lexing a window at a
+// time. tokens is initialized by the caller over the same source and emptied
+// between calls. dies once an invalid token is reached.
+void lexer_fill(Lexer* lexer, Tokens* tokens);
 
-Token* lexer_lex(int* size);
+// the same for the whole source, split at line ends into chunks lexed on up to
+// threads threads. tokens and symbols match lexer_lex.
+void lexer_lex_parallel(const char* source, size_t source_size, int threads, Tokens* tokens);
@@ -1,55 +1,396 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include "arena.h"
+#include "cgen.h"
+#include "closure.h"
 #include "common.h"
+#include "compiler.h"
+#include "effects.h"
+#include "flat.h"
 #include "interpreter.h"
+#include "jit.h"
 #include "lexer.h"
+#include "memo.h"
+#include "optimizer.h"
+#include "parallel.h"
 #include "parser.h"
+#include "resolver.h"
+#include "source.h"
+#include "symbol.h"
+#include "vm.h"
 
-static char* slurp_file(const char* filepath) {
-    FILE* file = fopen(filepath, "r");
-    if (!file) {
-        error_and_die("cannot open: %s", filepath);
+typedef enum {
+    ENGINE_TREE,
+    ENGINE_VM,
+    ENGINE_CLOSURE,
+    ENGINE_FLAT,
+} Engine;
+
+static double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static Engine parse_engine(const char* name) {
+    if (strcmp(name, "tree") == 0) {
+        return ENGINE_TREE;
+    } else if (strcmp(name, "vm") == 0) {
+        return ENGINE_VM;
+    } else if (strcmp(name, "closure") == 0) {
+        return ENGINE_CLOSURE;
+    } else if (strcmp(name, "flat") == 0) {
+        return ENGINE_FLAT;
+    }
+
+    error_and_die("unknown engine: %s", name);
+}
+
+// accepts a plain byte count or one suffixed with K, M or G.
+static size_t parse_size(const char* text) {
+    char* end = NULL;
+    unsigned long long size = strtoull(text, &end, 10);
+
+    if (end == text) {
+        error_and_die("invalid size: %s", text);
+    }
+
+    switch (*end) {
+        case 'K':
+            size *= 1024;
+            end++;
+            break;
+        case 'M':
+            size *= 1024 * 1024;
+            end++;
+            break;
+        case 'G':
+            size *= 1024 * 1024 * 1024;
+            end++;
+            break;
+        default:
+            break;
+    }
+
+    if (*end) {
+        error_and_die("invalid size: %s", text);
+    }
+
+    return size;
+}
+
+static int parse_count(const char* text, const char* what) {
+    char* end = NULL;
+    long count = strtol(text, &end, 10);
+
+    if (end == text || *end || count < 1 || count > INT_MAX) {
+        error_and_die("invalid %s: %s", what, text);
+    }
+
+    return count;
+}
+
+// names is NULL to memoize every pure function, or a comma separated list.
+static void enable_memo(Memo* memo, Module* module, const char* names) {
+    if (!names) {
+        for (int i = 0; i < module->fundecls_size; i++) {
+            if (module->fundecls[i].pure) {
+                memo_enable(memo, &module->fundecls[i]);
+            }
+        }
+        return;
     }
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    while (*names) {
+        const char* end = strchr(names, ',');
+        int size = end ? end - names : (int) strlen(names);
+
+        Span name = span_make(names, size);
+        FunctionDeclaration* fundecl = module_find_fundecl(module, symbol_intern(name));
+
+        if (!fundecl) {
+            error_and_die("no such function: "SPAN_FMT, SPAN_ARG(name));
+        }
 
-    char* buffer = malloc(sizeof(char) * size + 1);
-    buffer[size] = 0;
+        if (!fundecl->pure) {
+            error_and_die("cannot memoize: "SPAN_FMT" prints", SPAN_ARG(name));
+        }
 
-    fread(buffer, sizeof(char), size, file);
-    fclose(file);
+        memo_enable(memo, fundecl);
 
-    return buffer;
+        names += end ? size + 1 : size;
+    }
+}
+
+static void print_stats(InterpreterStats* stats, Heap* heap) {
+    fprintf(stderr, "calls: %ld\n", stats->calls);
+    fprintf(stderr, "allocations: %ld\n", stats->allocations);
+    fprintf(stderr, "frames peak: %d slots\n", stats->frames_peak);
+    fprintf(stderr, "field cache misses: %ld\n", stats->field_cache_misses);
+    fprintf(stderr, "binary quickenings: %ld, deopts: %ld\n", stats->quickenings, stats->deopts);
+
+    fprintf(stderr, "gc collections: %ld\n", heap->stats.collections);
+    fprintf(stderr, "gc objects: %ld allocated, %ld freed\n", heap->stats.objects_allocated, heap->stats.objects_freed);
+    fprintf(stderr, "gc bytes: %zu allocated, %zu freed, %zu live, %zu peak\n",
+            heap->stats.bytes_allocated, heap->stats.bytes_freed, heap->bytes, heap->stats.bytes_peak);
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    const char* filepath = NULL;
+    Engine engine = ENGINE_TREE;
+    bool stats = false;
+    size_t heap_size = 0;
+    bool gc_stress = false;
+    OptimizationLevel opt_level = OPT_LEVEL_1;
+    bool dump_ast = false;
+    bool emit_c = false;
+    bool jit = false;
+    int jit_threshold = JIT_DEFAULT_THRESHOLD;
+    bool memoize = false;
+    const char* memoize_names = NULL;
+    int memo_size = MEMO_DEFAULT_LIMIT;
+    int threads = 1;
+    int lex_threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--engine=", 9) == 0) {
+            engine = parse_engine(argv[i] + 9);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (strncmp(argv[i], "--heap-size=", 12) == 0) {
+            heap_size = parse_size(argv[i] + 12);
+        } else if (strcmp(argv[i], "--gc-stress") == 0) {
+            gc_stress = true;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            opt_level = OPT_LEVEL_0;
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            opt_level = OPT_LEVEL_1;
+        } else if (strcmp(argv[i], "-O2") == 0) {
+            opt_level = OPT_LEVEL_2;
+        } else if (strcmp(argv[i], "--dump-ast") == 0) {
+            dump_ast = true;
+        } else if (strcmp(argv[i], "--emit-c") == 0) {
+            emit_c = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit = true;
+        } else if (strncmp(argv[i], "--jit-threshold=", 16) == 0) {
+            jit = true;
+            jit_threshold = parse_count(argv[i] + 16, "jit threshold");
+        } else if (strcmp(argv[i], "--memoize") == 0) {
+            memoize = true;
+            memoize_names = NULL;
+        } else if (strncmp(argv[i], "--memoize=", 10) == 0) {
+            memoize = true;
+            memoize_names = argv[i] + 10;
+        } else if (strncmp(argv[i], "--memo-size=", 12) == 0) {
+            memo_size = parse_count(argv[i] + 12, "memo size");
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = parse_count(argv[i] + 10, "thread count");
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = parse_count(argv[++i], "thread count");
+        } else if (strncmp(argv[i], "--lex-threads=", 14) == 0) {
+            lex_threads = parse_count(argv[i] + 14, "thread count");
+        } else if (strcmp(argv[i], "-") == 0) {
+            filepath = argv[i];
+        } else if (strncmp(argv[i], "-", 1) == 0) {
+            error_and_die("unknown option: %s", argv[i]);
+        } else {
+            filepath = argv[i];
+        }
+    }
+
+    if (!filepath) {
         error_and_die("no input file provided");
     }
 
-    char* input_buffer = slurp_file(argv[1]);
-    lexer_init(input_buffer);
+    if (jit && engine != ENGINE_TREE) {
+        error_and_die("--jit only works with the tree engine");
+    }
 
-    int tokens_size = 0;
-    Token* tokens = lexer_lex(&tokens_size);
+    if (memoize && engine != ENGINE_TREE) {
+        error_and_die("--memoize only works with the tree engine");
+    }
 
+    if (threads > 1 && (engine != ENGINE_TREE || jit || memoize)) {
+        error_and_die("--threads only works with the tree engine, without --jit or --memoize");
+    }
+
+    struct timespec load_start;
+    clock_gettime(CLOCK_MONOTONIC, &load_start);
+
+    Source source;
+    source_open(&source, filepath);
+
+    if (stats) {
+        fprintf(stderr, "load: %zu bytes %s in %.3f ms\n", source.size, source.mapped ? "mapped" : "read",
+                seconds_since(&load_start) * 1000);
+    }
+
+    Arena arena;
+    arena_init(&arena);
+
+    // one thread lexes as the parser asks for tokens, more lex the whole source first.
+    Lexer lexer;
+    Tokens tokens = {0};
     Parser parser;
-    parser_init(&parser, tokens, tokens_size);
+
+    if (lex_threads > 1) {
+        lexer_lex_parallel(source.data, source.size, lex_threads, &tokens);
+        parser_init_tokens(&parser, &arena, &tokens);
+    } else {
+        lexer_init(&lexer, source.data, source.size);
+        parser_init(&parser, &arena, &lexer);
+    }
+
     Module module = parse_module(&parser);
+    parser_deinit(&parser);
+    tokens_free(&tokens);
 
-    Interpreter interpreter;
-    interpreter_init(&interpreter, &module);
+    Resolver resolver;
+    resolver_init(&resolver, &module);
+    resolve_module(&resolver);
+    resolver_deinit(&resolver);
 
-    int return_value = execute_module(&interpreter).as.integer;
+    optimize_module(&module, opt_level);
+    analyze_effects(&module);
 
-    interpreter_deinit(&interpreter);
+    int return_value = 0;
 
-    parser_deinit(&parser);
+    if (dump_ast) {
+        module_print(&module);
+        module_free(&module);
+    } else if (emit_c) {
+        cgen_module(&module, stdout);
+        module_free(&module);
+    } else if (engine == ENGINE_VM) {
+        Program program = compile_module(&module);
+
+        VM vm;
+        vm_init(&vm, &program);
+
+        vm.heap.limit = heap_size;
+        vm.heap.stress = gc_stress;
+
+        Object result = vm_run(&vm);
+        if (!object_is_int(result)) {
+            error_and_die("main function should return integer");
+        }
+
+        return_value = object_as_int(result);
+
+        if (stats) {
+            print_stats(&vm.stats, &vm.heap);
+        }
+
+        vm_deinit(&vm);
+        program_free(&program);
+        module_free(&module);
+    } else if (engine == ENGINE_CLOSURE) {
+        ClosureEngine closure_engine;
+        closure_engine_init(&closure_engine, &module);
+
+        closure_engine.heap.limit = heap_size;
+        closure_engine.heap.stress = gc_stress;
+
+        return_value = object_as_int(closure_engine_run(&closure_engine));
+
+        if (stats) {
+            print_stats(&closure_engine.stats, &closure_engine.heap);
+        }
+
+        closure_engine_deinit(&closure_engine);
+        module_free(&module);
+    } else if (engine == ENGINE_FLAT) {
+        FlatTree tree;
+        flat_tree_build(&tree, &module);
+
+        FlatEngine flat_engine;
+        flat_engine_init(&flat_engine, &tree, &module);
+
+        flat_engine.heap.limit = heap_size;
+        flat_engine.heap.stress = gc_stress;
+
+        return_value = object_as_int(flat_engine_run(&flat_engine));
+
+        if (stats) {
+            print_stats(&flat_engine.stats, &flat_engine.heap);
+        }
+
+        flat_engine_deinit(&flat_engine);
+        flat_tree_free(&tree);
+        module_free(&module);
+    } else {
+        Interpreter interpreter;
+        interpreter_init(&interpreter, &module);
+
+        interpreter.heap.limit = heap_size;
+        interpreter.heap.stress = gc_stress;
+
+        Jit jit_compiler;
+        if (jit) {
+            jit_init(&jit_compiler, &module, jit_threshold);
+            interpreter.jit = &jit_compiler;
+        }
+
+        Memo memo;
+        if (memoize) {
+            memo_init(&memo, &module, memo_size);
+            enable_memo(&memo, &module, memoize_names);
+            interpreter.memo = &memo;
+        }
+
+        Parallel parallel;
+        if (threads > 1) {
+            parallel_init(&parallel, &interpreter, threads);
+        }
+
+        return_value = object_as_int(execute_module(&interpreter));
+
+        if (stats) {
+            print_stats(&interpreter.stats, &interpreter.heap);
+        }
+
+        if (jit) {
+            if (stats) {
+                fprintf(stderr, "jit: %ld compiled, %ld failed, %ld native calls, %zu code bytes\n",
+                        jit_compiler.stats.compilations, jit_compiler.stats.failures,
+                        jit_compiler.stats.native_calls, jit_compiler.stats.code_bytes);
+            }
+
+            jit_deinit(&jit_compiler);
+        }
+
+        if (memoize) {
+            if (stats) {
+                fprintf(stderr, "memo: %ld hits, %ld misses, %ld evictions\n",
+                        memo.stats.hits, memo.stats.misses, memo.stats.evictions);
+            }
+
+            memo_deinit(&memo);
+        }
+
+        if (threads > 1) {
+            if (stats) {
+                ParallelStats parallel_counts = parallel_stats(&parallel);
+                fprintf(stderr, "parallel: %ld forks, %ld stolen, %ld rerun\n",
+                        parallel_counts.forks, parallel_counts.steals, parallel_counts.reruns);
+            }
+
+            parallel_deinit(&parallel);
+        }
+
+        interpreter_deinit(&interpreter);
+        module_free(&module);
+    }
+
+    source_close(&source);
 
-    free(input_buffer);
+    symbols_free();
 
     return return_value;
 }
@@ -0,0 +1,244 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "memo.h"
+
+static void* memo_alloc(size_t size) {
+    void* ptr = malloc(size);
+    if (!ptr) {
+        error_and_die("cannot allocate memory");
+    }
+
+    return ptr;
+}
+
+void memo_init(Memo* memo, Module* module, int limit) {
+    assert(memo != NULL);
+    assert(module != NULL);
+    assert(limit > 0);
+
+    memo->module = module;
+    memo->limit = limit;
+
+    memo->tables = memo_alloc(sizeof(MemoTable) * (module->fundecls_size + 1));
+    for (int i = 0; i < module->fundecls_size; i++) {
+        memo->tables[i] = (MemoTable) {
+            .enabled = false,
+            .args_size = module->fundecls[i].args_size,
+            .head = -1,
+            .tail = -1,
+        };
+    }
+
+    memo->pending = NULL;
+    memo->pending_size = 0;
+    memo->pending_cap = 0;
+
+    memo->stats = (MemoStats) {0};
+}
+
+void memo_deinit(Memo* memo) {
+    assert(memo != NULL);
+
+    for (int i = 0; i < memo->module->fundecls_size; i++) {
+        MemoTable* table = &memo->tables[i];
+
+        free(table->entries);
+        free(table->keys);
+        free(table->buckets);
+    }
+
+    free(memo->tables);
+    free(memo->pending);
+}
+
+void memo_enable(Memo* memo, FunctionDeclaration* fundecl) {
+    assert(fundecl->pure);
+
+    MemoTable* table = &memo->tables[fundecl - memo->module->fundecls];
+    if (table->enabled)
+        return;
+
+    table->enabled = true;
+
+    table->entries = memo_alloc(sizeof(MemoEntry) * memo->limit);
+    table->keys = memo_alloc(sizeof(Object) * ((size_t) memo->limit * table->args_size + 1));
+
+    // at most half full, chains stay short.
+    table->buckets_cap = 1;
+    while (table->buckets_cap < 2 * memo->limit) {
+        table->buckets_cap *= 2;
+    }
+
+    table->buckets = memo_alloc(sizeof(int) * table->buckets_cap);
+    for (int i = 0; i < table->buckets_cap; i++) {
+        table->buckets[i] = -1;
+    }
+}
+
+// boxed ints are compared by value, everything else by its bits. records are
+// immutable, the same instance always gives the same result.
+static uint64_t hash_args(Object* args, int args_size) {
+    uint64_t hash = 0x9e3779b97f4a7c15u;
+
+    for (int i = 0; i < args_size; i++) {
+        uint64_t bits = object_is_boxed_int(args[i]) ? (uint64_t) object_as_int(args[i]) : args[i].bits;
+
+        hash ^= bits + 0x9e3779b97f4a7c15u + (hash << 6) + (hash >> 2);
+    }
+
+    // final mix of splitmix64, the low bits pick the bucket.
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9u;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebu;
+    hash ^= hash >> 31;
+
+    return hash;
+}
+
+static bool args_equal(Object* lhs, Object* rhs, int args_size) {
+    for (int i = 0; i < args_size; i++) {
+        if (lhs[i].bits == rhs[i].bits)
+            continue;
+
+        if (!object_is_boxed_int(lhs[i]) || !object_is_boxed_int(rhs[i]) || object_as_int(lhs[i]) != object_as_int(rhs[i]))
+            return false;
+    }
+
+    return true;
+}
+
+static void lru_unlink(MemoTable* table, int index) {
+    MemoEntry* entry = &table->entries[index];
+
+    if (entry->prev >= 0) {
+        table->entries[entry->prev].next = entry->next;
+    } else {
+        table->head = entry->next;
+    }
+
+    if (entry->next >= 0) {
+        table->entries[entry->next].prev = entry->prev;
+    } else {
+        table->tail = entry->prev;
+    }
+}
+
+static void lru_push_front(MemoTable* table, int index) {
+    MemoEntry* entry = &table->entries[index];
+
+    entry->prev = -1;
+    entry->next = table->head;
+
+    if (table->head >= 0) {
+        table->entries[table->head].prev = index;
+    } else {
+        table->tail = index;
+    }
+
+    table->head = index;
+}
+
+bool memo_lookup(Memo* memo, FunctionDeclaration* fundecl, Object* args, Object* result) {
+    MemoTable* table = &memo->tables[fundecl - memo->module->fundecls];
+    assert(table->enabled);
+
+    uint64_t hash = hash_args(args, table->args_size);
+
+    int index = table->buckets[hash & (table->buckets_cap - 1)];
+    for (; index >= 0; index = table->entries[index].chain) {
+        MemoEntry* entry = &table->entries[index];
+
+        if (entry->hash == hash && args_equal(&table->keys[(size_t) index * table->args_size], args, table->args_size)) {
+            if (table->head != index) {
+                lru_unlink(table, index);
+                lru_push_front(table, index);
+            }
+
+            *result = entry->result;
+            memo->stats.hits++;
+
+            return true;
+        }
+    }
+
+    memo->stats.misses++;
+
+    if (memo->pending_size + table->args_size > memo->pending_cap) {
+        while (memo->pending_size + table->args_size > memo->pending_cap) {
+            memo->pending_cap = memo->pending_cap ? memo->pending_cap * 2 : 64;
+        }
+
+        memo->pending = realloc(memo->pending, sizeof(Object) * memo->pending_cap);
+        if (!memo->pending) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    memcpy(&memo->pending[memo->pending_size], args, sizeof(Object) * table->args_size);
+    memo->pending_size += table->args_size;
+
+    return false;
+}
+
+static void bucket_unlink(MemoTable* table, int index) {
+    int* link = &table->buckets[table->entries[index].hash & (table->buckets_cap - 1)];
+
+    while (*link != index) {
+        link = &table->entries[*link].chain;
+    }
+
+    *link = table->entries[index].chain;
+}
+
+void memo_store(Memo* memo, FunctionDeclaration* fundecl, Object result) {
+    MemoTable* table = &memo->tables[fundecl - memo->module->fundecls];
+    assert(table->enabled);
+    assert(memo->pending_size >= table->args_size);
+
+    memo->pending_size -= table->args_size;
+    Object* args = &memo->pending[memo->pending_size];
+
+    int index;
+    if (table->entries_size < memo->limit) {
+        index = table->entries_size++;
+    } else {
+        index = table->tail;
+
+        lru_unlink(table, index);
+        bucket_unlink(table, index);
+
+        memo->stats.evictions++;
+    }
+
+    MemoEntry* entry = &table->entries[index];
+    entry->result = result;
+    entry->hash = hash_args(args, table->args_size);
+
+    memcpy(&table->keys[(size_t) index * table->args_size], args, sizeof(Object) * table->args_size);
+
+    int* bucket = &table->buckets[entry->hash & (table->buckets_cap - 1)];
+    entry->chain = *bucket;
+    *bucket = index;
+
+    lru_push_front(table, index);
+}
+
+void memo_mark(Memo* memo, Heap* heap) {
+    heap_mark_objects(heap, memo->pending, memo->pending_size);
+
+    for (int i = 0; i < memo->module->fundecls_size; i++) {
+        MemoTable* table = &memo->tables[i];
+        if (!table->enabled)
+            continue;
+
+        heap_mark_objects(heap, table->keys, table->entries_size * table->args_size);
+
+        for (int j = 0; j < table->entries_size; j++) {
+            heap_mark_objects(heap, &table->entries[j].result, 1);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "gc.h"
+#include "object.h"
+
+typedef struct {
+    long hits;
+    long misses;
+    long evictions;
+} MemoStats;
+
+typedef struct {
+    Object result;
+
+    int chain;      // next entry in the same bucket, or -1
+    int prev;       // towards the most recently used entry, or -1
+    int next;       // towards the least recently used entry, or -1
+    uint64_t hash;
+} MemoEntry;
+
+// results of one function keyed by its arguments, evicting the least recently
+// used entry once limit entries are cached.
+typedef struct {
+    bool enabled;
+    int args_size;
+
+    MemoEntry* entries;
+    int entries_size;
+
+    Object* keys; // args_size per entry
+
+    int* buckets;
+    int buckets_cap;
+
+    int head; // most recently used
+    int tail; // least recently used
+} MemoTable;
+
+// opt-in cache for calls of pure functions.
+typedef struct {
+    Module* module;
+    int limit;
+
+    MemoTable* tables; // parallel to module->fundecls
+
+    // arguments of the calls being computed, kept alive until their result is stored.
+    Object* pending;
+    int pending_size;
+    int pending_cap;
+
+    MemoStats stats;
+} Memo;
+
+#define MEMO_DEFAULT_LIMIT 4096
+
+void memo_init(Memo* memo, Module* module, int limit);
+void memo_deinit(Memo* memo);
+
+// enables the cache for a function, which has to be pure.
+void memo_enable(Memo* memo, FunctionDeclaration* fundecl);
+
+static inline bool memo_enabled(Memo* memo, FunctionDeclaration* fundecl) {
+    return memo->tables[fundecl - memo->module->fundecls].enabled;
+}
+
+// on a miss the arguments are remembered until memo_store is given the result,
+// calls of memoized functions nest so they are paired up like a stack.
+bool memo_lookup(Memo* memo, FunctionDeclaration* fundecl, Object* args, Object* result);
+void memo_store(Memo* memo, FunctionDeclaration* fundecl, Object result);
+
+void memo_mark(Memo* memo, Heap* heap);
@@ -0,0 +1,80 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "object.h"
+
+Object object_static_int(Arena* arena, int64_t value) {
+    if (object_fits_small_int(value)) {
+        return object_small_int(value);
+    }
+
+    ObjInt* box = arena_alloc(arena, sizeof(ObjInt));
+    box->obj = (Obj) {
+        .next = NULL,
+        .type = OBJ_INT,
+        .marked = true,
+    };
+    box->value = value;
+
+    return object_boxed_int(box);
+}
+
+void object_box_literal(Arena* arena, Value* value) {
+    assert(value->type == VAL_INT);
+
+    value->as.boxed = NULL;
+
+    if (!object_fits_small_int(value->as.integer)) {
+        value->as.boxed = (ObjInt*) object_as_obj(object_static_int(arena, value->as.integer));
+    }
+}
+
+void object_print(Object* object) {
+    switch (object_type(*object)) {
+        case OBJ_INT:
+            printf("%ld ", object_as_int(*object));
+            break;
+        case OBJ_FLOAT:
+            printf("%.*f ", 15, object_as_float(*object));
+            break;
+        case OBJ_RECORD: {
+            ObjRecord* record = object_as_record(*object);
+            Record* shape = record->shape;
+
+            printf(SPAN_FMT" [ ", SPAN_ARG(shape->id));
+            for (int i = 0; i < shape->fields_size; i++) {
+                printf(""SPAN_FMT": ", SPAN_ARG(shape->fields[i].id));
+                object_print(&record->fields[i]);
+            }
+            printf("] ");
+            break;
+        }
+        case OBJ_VOID:
+            error_and_die("cannot print void value");
+    }
+}
+
+int object_field_find(Object* object, FieldAccess* field_access) {
+    if (!object_is_record(*object)) {
+        error_and_die("cannot access field: "SPAN_FMT" of a non record value", SPAN_ARG(field_access->field));
+    }
+
+    Record* shape = object_as_record(*object)->shape;
+
+    int offset = record_find_field(shape, field_access->symbol);
+    if (offset < 0) {
+        error_and_die("record: "SPAN_FMT" has no field: "SPAN_FMT, SPAN_ARG(shape->id), SPAN_ARG(field_access->field));
+    }
+
+    return offset;
+}
+
+int object_field_offset(Object* object, FieldAccess* field_access) {
+    int offset = object_field_find(object, field_access);
+
+    field_access->cached_shape = object_as_record(*object)->shape;
+    field_access->cached_offset = offset;
+
+    return offset;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "ast.h"
+
+typedef struct Obj_t Obj;
+typedef struct ObjRecord_t ObjRecord;
+typedef struct ObjInt_t ObjInt;
+
+typedef enum {
+    OBJ_INT,
+    OBJ_FLOAT,
+    OBJ_RECORD,
+    OBJ_VOID,
+} ObjectType;
+
+// a value is a single NaN boxed word. every bit pattern that is not one of our
+// quiet NaNs is a float. a quiet NaN with the sign bit set carries a 50 bit
+// integer, without it the low 48 bits point to a heap object tagged by bits 48-49
+// (a null pointer is void). integers too wide to fit are boxed on the heap.
+typedef struct {
+    uint64_t bits;
+} Object;
+
+#define OBJECT_QNAN        ((uint64_t) 0x7ffc000000000000)
+#define OBJECT_INT_TAG     ((uint64_t) 0xfffc000000000000)
+#define OBJECT_PTR_TAG     ((uint64_t) 0x0003000000000000)
+#define OBJECT_PTR_MASK    ((uint64_t) 0x0000ffffffffffff)
+#define OBJECT_RECORD_TAG  ((uint64_t) 0x0001000000000000)
+#define OBJECT_BOXINT_TAG  ((uint64_t) 0x0002000000000000)
+#define OBJECT_NAN         ((uint64_t) 0xfff8000000000000) // the default NaN of x86, prints as -nan
+
+#define OBJECT_INT_BITS 50
+#define OBJECT_INT_MIN  (-((int64_t) 1 << (OBJECT_INT_BITS - 1)))
+#define OBJECT_INT_MAX  (((int64_t) 1 << (OBJECT_INT_BITS - 1)) - 1)
+
+// common header of everything owned by a heap.
+struct Obj_t {
+    Obj* next; // every object owned by a heap is linked together
+    ObjectType type;
+    bool marked;
+};
+
+// a record instance, a single allocation holding only the field values.
+// field names and count come from the record declaration, shared by every instance.
+struct ObjRecord_t {
+    Obj obj;
+    Record* shape;
+
+    Object fields[];
+};
+
+// an integer outside of the inline range.
+struct ObjInt_t {
+    Obj obj;
+    int64_t value;
+};
+
+static inline bool object_is_float(Object object) {
+    return (object.bits & OBJECT_QNAN) != OBJECT_QNAN;
+}
+
+static inline bool object_is_small_int(Object object) {
+    return (object.bits & OBJECT_INT_TAG) == OBJECT_INT_TAG;
+}
+
+static inline bool object_is_heap(Object object) {
+    return (object.bits & OBJECT_INT_TAG) == OBJECT_QNAN && (object.bits & OBJECT_PTR_TAG) != 0;
+}
+
+static inline bool object_is_record(Object object) {
+    return (object.bits & (OBJECT_INT_TAG | OBJECT_PTR_TAG)) == (OBJECT_QNAN | OBJECT_RECORD_TAG);
+}
+
+static inline bool object_is_boxed_int(Object object) {
+    return (object.bits & (OBJECT_INT_TAG | OBJECT_PTR_TAG)) == (OBJECT_QNAN | OBJECT_BOXINT_TAG);
+}
+
+static inline bool object_is_int(Object object) {
+    return object_is_small_int(object) || object_is_boxed_int(object);
+}
+
+static inline bool object_is_void(Object object) {
+    return object.bits == OBJECT_QNAN;
+}
+
+static inline bool object_fits_small_int(int64_t value) {
+    return value >= OBJECT_INT_MIN && value <= OBJECT_INT_MAX;
+}
+
+static inline ObjectType object_type(Object object) {
+    if (object_is_float(object))
+        return OBJ_FLOAT;
+    if (object_is_small_int(object) || object_is_boxed_int(object))
+        return OBJ_INT;
+    if (object_is_record(object))
+        return OBJ_RECORD;
+    return OBJ_VOID;
+}
+
+static inline Object object_float(double value) {
+    Object object;
+    memcpy(&object.bits, &value, sizeof(double));
+
+    // NaNs produced by arithmetic could carry a payload that looks like a tag,
+    // they all become the NaN that 0.0 / 0.0 gives.
+    if (value != value) {
+        object.bits = OBJECT_NAN;
+    }
+
+    return object;
+}
+
+static inline double object_as_float(Object object) {
+    double value;
+    memcpy(&value, &object.bits, sizeof(double));
+    return value;
+}
+
+static inline Object object_small_int(int64_t value) {
+    assert(object_fits_small_int(value));
+    return (Object) { .bits = OBJECT_INT_TAG | ((uint64_t) value & ~OBJECT_INT_TAG) };
+}
+
+static inline int64_t object_as_small_int(Object object) {
+    // shift the payload up against the sign bit and back to sign extend it.
+    return (int64_t) (object.bits << (64 - OBJECT_INT_BITS)) >> (64 - OBJECT_INT_BITS);
+}
+
+static inline Obj* object_as_obj(Object object) {
+    return (Obj*) (uintptr_t) (object.bits & OBJECT_PTR_MASK);
+}
+
+static inline ObjRecord* object_as_record(Object object) {
+    return (ObjRecord*) object_as_obj(object);
+}
+
+static inline int64_t object_as_int(Object object) {
+    if (object_is_small_int(object))
+        return object_as_small_int(object);
+    return ((ObjInt*) object_as_obj(object))->value;
+}
+
+static inline Object object_void(void) {
+    return (Object) { .bits = OBJECT_QNAN };
+}
+
+static inline Object object_record(ObjRecord* record) {
+    assert(((uintptr_t) record & ~OBJECT_PTR_MASK) == 0);
+    return (Object) { .bits = OBJECT_QNAN | OBJECT_RECORD_TAG | (uintptr_t) record };
+}
+
+static inline Object object_boxed_int(ObjInt* box) {
+    assert(((uintptr_t) box & ~OBJECT_PTR_MASK) == 0);
+    return (Object) { .bits = OBJECT_QNAN | OBJECT_BOXINT_TAG | (uintptr_t) box };
+}
+
+// an integer that lives as long as the arena, e.g. a constant. wide ones are boxed
+// in the arena already marked, so the collector neither traces nor frees them.
+Object object_static_int(Arena* arena, int64_t value);
+
+// boxes an integer literal of the tree that is too wide to be inline, so running
+// it never allocates.
+void object_box_literal(Arena* arena, Value* value);
+
+void object_print(Object* object);
+
+// slow path of a field access, looks the field up in the record's shape and
+// refills the site's inline cache. dies if object has no such field.
+int object_field_offset(Object* object, FieldAccess* field_access);
+
+// the same lookup leaving the cache alone, for trees shared between threads.
+int object_field_find(Object* object, FieldAccess* field_access);
@@ -0,0 +1,503 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "object.h"
+#include "optimizer.h"
+
+// what is known about one frame slot of the function being optimized.
+typedef struct {
+    Span id;
+    Symbol symbol;
+    LetBlock* letblock; // declaring let block, NULL for arguments
+
+    int assignments;     // stores anywhere in the function
+    int own_assignments; // stores made by the declaring let block itself
+    int reads;
+
+    // a stable slot holds a single value from its assignment on, arguments
+    // that are never assigned are stable from the start of the function.
+    bool stable;
+    bool ready; // the stable value has been assigned at this point of the walk
+
+    Expression* constant; // literal the slot is known to hold, or NULL
+    int alias;            // stable slot known to hold the same value, or -1
+} SlotInfo;
+
+typedef struct {
+    Module* module;
+    OptimizationLevel level;
+
+    SlotInfo* slots;
+    int slots_cap;
+} Optimizer;
+
+static bool expression_is_literal(Expression* expression) {
+    return expression->type == EXPR_PRIMARY
+        && (expression->as.primary.type == VAL_INT || expression->as.primary.type == VAL_FLOAT);
+}
+
+// true if evaluating the expression can neither fail nor be observed.
+static bool expression_is_pure(Optimizer* optimizer, Expression* expression) {
+    if (expression->type != EXPR_PRIMARY)
+        return false;
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_INT:
+        case VAL_FLOAT:
+        case VAL_IDENT:
+            return true;
+        case VAL_RECORD_CREATION: {
+            Record* record = module_find_record(optimizer->module, value->as.record_creation.symbol);
+            if (!record || record->fields_size != value->as.record_creation.args_size)
+                return false;
+
+            for (int i = 0; i < value->as.record_creation.args_size; i++) {
+                if (!expression_is_pure(optimizer, value->as.record_creation.args[i]))
+                    return false;
+            }
+
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static void set_literal(Expression* expression, Value value) {
+    expression->type = EXPR_PRIMARY;
+    expression->as.primary = value;
+}
+
+static bool fold_int(BinaryExpressionType type, int64_t lhs, int64_t rhs, int64_t* result) {
+    switch (type) {
+        // overflowing or trapping operations are left for the runtime.
+        case BIN_ADD: return !__builtin_add_overflow(lhs, rhs, result);
+        case BIN_SUB: return !__builtin_sub_overflow(lhs, rhs, result);
+        case BIN_MUL: return !__builtin_mul_overflow(lhs, rhs, result);
+        case BIN_DIV:
+            if (rhs == 0 || (lhs == INT64_MIN && rhs == -1))
+                return false;
+            *result = lhs / rhs;
+            return true;
+        case BIN_EQU: *result = lhs == rhs; return true;
+        case BIN_NEQU: *result = lhs != rhs; return true;
+        case BIN_GT: *result = lhs > rhs; return true;
+        case BIN_LT: *result = lhs < rhs; return true;
+        case BIN_GTEQ: *result = lhs >= rhs; return true;
+        case BIN_LTEQ: *result = lhs <= rhs; return true;
+        case BIN_AND: *result = lhs && rhs; return true;
+        case BIN_OR: *result = lhs || rhs; return true;
+    }
+
+    return false;
+}
+
+static Value fold_float(BinaryExpressionType type, double lhs, double rhs) {
+    switch (type) {
+        case BIN_ADD: return (Value) { .type = VAL_FLOAT, .as.floating = lhs + rhs };
+        case BIN_SUB: return (Value) { .type = VAL_FLOAT, .as.floating = lhs - rhs };
+        case BIN_MUL: return (Value) { .type = VAL_FLOAT, .as.floating = lhs * rhs };
+        case BIN_DIV: return (Value) { .type = VAL_FLOAT, .as.floating = lhs / rhs };
+        case BIN_EQU: return (Value) { .type = VAL_INT, .as.integer = lhs == rhs };
+        case BIN_NEQU: return (Value) { .type = VAL_INT, .as.integer = lhs != rhs };
+        case BIN_GT: return (Value) { .type = VAL_INT, .as.integer = lhs > rhs };
+        case BIN_LT: return (Value) { .type = VAL_INT, .as.integer = lhs < rhs };
+        case BIN_GTEQ: return (Value) { .type = VAL_INT, .as.integer = lhs >= rhs };
+        case BIN_LTEQ: return (Value) { .type = VAL_INT, .as.integer = lhs <= rhs };
+        case BIN_AND: return (Value) { .type = VAL_INT, .as.integer = lhs && rhs };
+        case BIN_OR: return (Value) { .type = VAL_INT, .as.integer = lhs || rhs };
+    }
+
+    error_and_die("unreachable");
+}
+
+// replaces a binary expression over two literals of the same type by its value.
+// mismatched operands are kept, so the runtime still reports them.
+static void fold_binary(Optimizer* optimizer, Expression* expression) {
+    BinaryExpression* binary = &expression->as.binary;
+
+    if (!expression_is_literal(binary->lhs) || !expression_is_literal(binary->rhs))
+        return;
+
+    Value* lhs = &binary->lhs->as.primary;
+    Value* rhs = &binary->rhs->as.primary;
+
+    if (lhs->type != rhs->type)
+        return;
+
+    if (lhs->type == VAL_INT) {
+        int64_t result;
+        if (fold_int(binary->type, lhs->as.integer, rhs->as.integer, &result)) {
+            set_literal(expression, (Value) { .type = VAL_INT, .as.integer = result });
+            object_box_literal(optimizer->module->arena, &expression->as.primary);
+        }
+    } else {
+        set_literal(expression, fold_float(binary->type, lhs->as.floating, rhs->as.floating));
+    }
+}
+
+static void optimize_expression(Optimizer* optimizer, Expression* expression) {
+    switch (expression->type) {
+        case EXPR_PRIMARY: {
+            Value* value = &expression->as.primary;
+
+            switch (value->type) {
+                case VAL_IDENT: {
+                    if (optimizer->level < OPT_LEVEL_2)
+                        break;
+
+                    SlotInfo* info = &optimizer->slots[value->as.identifier.slot];
+                    if (!info->stable || !info->ready)
+                        break;
+
+                    if (info->constant) {
+                        set_literal(expression, info->constant->as.primary);
+                    } else if (info->alias >= 0) {
+                        SlotInfo* alias = &optimizer->slots[info->alias];
+
+                        value->as.identifier = (Identifier) {
+                            .id = alias->id,
+                            .symbol = alias->symbol,
+                            .slot = info->alias,
+                        };
+                    }
+                    break;
+                }
+                case VAL_FUNCALL:
+                    for (int i = 0; i < value->as.funcall.args_size; i++) {
+                        optimize_expression(optimizer, value->as.funcall.args[i]);
+                    }
+                    break;
+                case VAL_RECORD_CREATION:
+                    for (int i = 0; i < value->as.record_creation.args_size; i++) {
+                        optimize_expression(optimizer, value->as.record_creation.args[i]);
+                    }
+                    break;
+                case VAL_FIELD_ACCESS:
+                    optimize_expression(optimizer, value->as.field_access.expr);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        case EXPR_BINARY:
+            optimize_expression(optimizer, expression->as.binary.lhs);
+            optimize_expression(optimizer, expression->as.binary.rhs);
+            fold_binary(optimizer, expression);
+            break;
+    }
+}
+
+static void optimize_let_block(Optimizer* optimizer, LetBlock* letblock) {
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        Assignment* assignment = &letblock->assignments[i];
+
+        optimize_expression(optimizer, assignment->expr);
+
+        if (optimizer->level < OPT_LEVEL_2)
+            continue;
+
+        SlotInfo* info = &optimizer->slots[assignment->slot];
+        if (!info->stable || info->letblock != letblock)
+            continue;
+
+        // later assignments of this let block and everything after it see the value.
+        info->ready = true;
+
+        Expression* expr = assignment->expr;
+        if (expression_is_literal(expr)) {
+            info->constant = expr;
+        } else if (expr->type == EXPR_PRIMARY && expr->as.primary.type == VAL_IDENT) {
+            int source = expr->as.primary.as.identifier.slot;
+
+            if (optimizer->slots[source].stable && optimizer->slots[source].ready) {
+                info->alias = source;
+            }
+        }
+    }
+}
+
+static void push_statement(Optimizer* optimizer, Block* block, Statement statement) {
+    block->children = arena_reserve(optimizer->module->arena, block->children, block->children_size, &block->children_cap, sizeof(Statement));
+    block->children[block->children_size++] = statement;
+}
+
+static bool declares_let(Block* block) {
+    for (int i = 0; i < block->children_size; i++) {
+        if (block->children[i].type == STMT_LETBLOCK)
+            return true;
+    }
+
+    return false;
+}
+
+static void optimize_block(Optimizer* optimizer, Block* block) {
+    Statement* children = block->children;
+    int children_size = block->children_size;
+
+    block->children = NULL;
+    block->children_size = 0;
+    block->children_cap = 0;
+
+    for (int i = 0; i < children_size; i++) {
+        Statement* statement = &children[i];
+
+        switch (statement->type) {
+            case STMT_LETBLOCK:
+                optimize_let_block(optimizer, &statement->as.letblock);
+                break;
+            case STMT_IF: {
+                IfStatement* ifstatement = &statement->as.ifstatement;
+
+                optimize_expression(optimizer, ifstatement->expr);
+
+                // the resolver already bound every slot, so the taken branch can be
+                // spliced into this block without changing what its names refer to.
+                Expression* expr = ifstatement->expr;
+                Block* taken = NULL;
+                if (expr->type == EXPR_PRIMARY && expr->as.primary.type == VAL_INT) {
+                    taken = expr->as.primary.as.integer ? ifstatement->true_block : ifstatement->false_block;
+                }
+
+                // an empty branch or one ending in a let block is an error left for the runtime to report.
+                if (taken && taken->children_size > 0 && taken->children[taken->children_size - 1].type != STMT_LETBLOCK) {
+                    optimize_block(optimizer, taken);
+
+                    // a let of the branch would shadow the names of the statements after
+                    // it in the source --dump-ast prints, so such a branch stays nested.
+                    if (!declares_let(taken)) {
+                        for (int j = 0; j < taken->children_size; j++) {
+                            push_statement(optimizer, block, taken->children[j]);
+                        }
+                        continue;
+                    }
+
+                    optimize_block(optimizer, taken == ifstatement->true_block ? ifstatement->false_block : ifstatement->true_block);
+                    break;
+                }
+
+                optimize_block(optimizer, ifstatement->true_block);
+                optimize_block(optimizer, ifstatement->false_block);
+                break;
+            }
+            case STMT_EXPRESSION:
+                optimize_expression(optimizer, statement->as.expression);
+                break;
+        }
+
+        push_statement(optimizer, block, *statement);
+    }
+}
+
+static void count_expression(Optimizer* optimizer, Expression* expression) {
+    switch (expression->type) {
+        case EXPR_PRIMARY: {
+            Value* value = &expression->as.primary;
+
+            switch (value->type) {
+                case VAL_IDENT:
+                    optimizer->slots[value->as.identifier.slot].reads++;
+                    break;
+                case VAL_FUNCALL:
+                    for (int i = 0; i < value->as.funcall.args_size; i++) {
+                        count_expression(optimizer, value->as.funcall.args[i]);
+                    }
+                    break;
+                case VAL_RECORD_CREATION:
+                    for (int i = 0; i < value->as.record_creation.args_size; i++) {
+                        count_expression(optimizer, value->as.record_creation.args[i]);
+                    }
+                    break;
+                case VAL_FIELD_ACCESS:
+                    count_expression(optimizer, value->as.field_access.expr);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        case EXPR_BINARY:
+            count_expression(optimizer, expression->as.binary.lhs);
+            count_expression(optimizer, expression->as.binary.rhs);
+            break;
+    }
+}
+
+// records the declarations and stores of every slot, and counts the reads.
+static void count_block(Optimizer* optimizer, Block* block) {
+    for (int i = 0; i < block->children_size; i++) {
+        Statement* statement = &block->children[i];
+
+        switch (statement->type) {
+            case STMT_LETBLOCK: {
+                LetBlock* letblock = &statement->as.letblock;
+
+                for (int j = 0; j < letblock->ids_size; j++) {
+                    SlotInfo* info = &optimizer->slots[letblock->ids[j].slot];
+                    info->id = letblock->ids[j].id;
+                    info->symbol = letblock->ids[j].symbol;
+                    info->letblock = letblock;
+                }
+
+                for (int j = 0; j < letblock->assignments_size; j++) {
+                    Assignment* assignment = &letblock->assignments[j];
+                    SlotInfo* info = &optimizer->slots[assignment->slot];
+
+                    info->assignments++;
+                    if (info->letblock == letblock) {
+                        info->own_assignments++;
+                    }
+
+                    count_expression(optimizer, assignment->expr);
+                }
+                break;
+            }
+            case STMT_IF:
+                count_expression(optimizer, statement->as.ifstatement.expr);
+                count_block(optimizer, statement->as.ifstatement.true_block);
+                count_block(optimizer, statement->as.ifstatement.false_block);
+                break;
+            case STMT_EXPRESSION:
+                count_expression(optimizer, statement->as.expression);
+                break;
+        }
+    }
+}
+
+static void count_function(Optimizer* optimizer, FunctionDeclaration* fundecl) {
+    if (fundecl->slots_size > optimizer->slots_cap) {
+        optimizer->slots_cap = fundecl->slots_size;
+        optimizer->slots = realloc(optimizer->slots, sizeof(SlotInfo) * optimizer->slots_cap);
+        if (!optimizer->slots) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    for (int i = 0; i < fundecl->slots_size; i++) {
+        optimizer->slots[i] = (SlotInfo) {
+            .alias = -1,
+        };
+    }
+
+    for (int i = 0; i < fundecl->args_size; i++) {
+        optimizer->slots[i].id = fundecl->args[i].id;
+        optimizer->slots[i].symbol = fundecl->args[i].symbol;
+    }
+
+    count_block(optimizer, fundecl->block);
+}
+
+// drops stores to slots that are never read and statements without effects.
+// returns true if anything was removed.
+static bool eliminate_block(Optimizer* optimizer, Block* block) {
+    bool changed = false;
+    int size = 0;
+
+    for (int i = 0; i < block->children_size; i++) {
+        Statement* statement = &block->children[i];
+        bool last = i == block->children_size - 1;
+
+        switch (statement->type) {
+            case STMT_LETBLOCK: {
+                LetBlock* letblock = &statement->as.letblock;
+                int assignments_size = 0;
+
+                for (int j = 0; j < letblock->assignments_size; j++) {
+                    Assignment* assignment = &letblock->assignments[j];
+
+                    if (optimizer->slots[assignment->slot].reads == 0 && expression_is_pure(optimizer, assignment->expr)) {
+                        changed = true;
+                        continue;
+                    }
+
+                    letblock->assignments[assignments_size++] = *assignment;
+                }
+
+                letblock->assignments_size = assignments_size;
+
+                // stores of later let blocks still need the declaration, they are
+                // kept when they have effects.
+                bool unused = true;
+                for (int j = 0; j < letblock->ids_size; j++) {
+                    SlotInfo* info = &optimizer->slots[letblock->ids[j].slot];
+                    if (info->reads > 0 || info->assignments > info->own_assignments) {
+                        unused = false;
+                    }
+                }
+
+                if (!last && assignments_size == 0 && unused) {
+                    changed = true;
+                    continue;
+                }
+                break;
+            }
+            case STMT_IF:
+                changed |= eliminate_block(optimizer, statement->as.ifstatement.true_block);
+                changed |= eliminate_block(optimizer, statement->as.ifstatement.false_block);
+                break;
+            case STMT_EXPRESSION:
+                // the last statement is the value of the block.
+                if (!last && expression_is_pure(optimizer, statement->as.expression)) {
+                    changed = true;
+                    continue;
+                }
+                break;
+        }
+
+        block->children[size++] = *statement;
+    }
+
+    block->children_size = size;
+
+    return changed;
+}
+
+static void optimize_function_declaration(Optimizer* optimizer, FunctionDeclaration* fundecl) {
+    if (optimizer->level >= OPT_LEVEL_2) {
+        count_function(optimizer, fundecl);
+
+        for (int i = 0; i < fundecl->slots_size; i++) {
+            SlotInfo* info = &optimizer->slots[i];
+
+            if (info->letblock) {
+                info->stable = info->assignments == 1 && info->own_assignments == 1;
+            } else {
+                info->stable = info->assignments == 0;
+                info->ready = true;
+            }
+        }
+    }
+
+    optimize_block(optimizer, fundecl->block);
+
+    if (optimizer->level >= OPT_LEVEL_2) {
+        // removing a store can leave the slots it read unread in turn.
+        do {
+            count_function(optimizer, fundecl);
+        } while (eliminate_block(optimizer, fundecl->block));
+    }
+}
+
+void optimize_module(Module* module, OptimizationLevel level) {
+    assert(module != NULL);
+
+    if (level == OPT_LEVEL_0)
+        return;
+
+    Optimizer optimizer = {
+        .module = module,
+        .level = level,
+    };
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        optimize_function_declaration(&optimizer, &module->fundecls[i]);
+    }
+
+    if (optimizer.slots) {
+        free(optimizer.slots);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ast.h"
+
+typedef enum {
+    OPT_LEVEL_0, // leave the tree as parsed
+    OPT_LEVEL_1, // constant folding, dead if branches
+    OPT_LEVEL_2, // also propagation of let bindings and dead let elimination
+} OptimizationLevel;
+
+// rewrites the bodies of a resolved module in place, new nodes come from the module's arena.
+void optimize_module(Module* module, OptimizationLevel level);
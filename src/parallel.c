@@ -0,0 +1,698 @@
+#include <assert.h>
+#include <sched.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "parallel.h"
+
+#define SLOT(scope, slot) (interpreter->frames[(scope)->base + (slot)])
+
+// failed steals before an idle worker goes to sleep.
+#define PARALLEL_SPINS 64
+
+typedef enum {
+    RESULT_OBJECT,    // an inline int or a float, valid in any heap
+    RESULT_INT,       // an int that has to be boxed in the owner's heap
+    RESULT_UNMOVABLE, // a record, the owner computes it again
+    RESULT_FAILED,    // raised an error, the message is kept for the join
+} ParallelResultType;
+
+// a call of a pure function on numbers, run by the owner or by a thief.
+struct ParallelTask_t {
+    FunctionDeclaration* fundecl;
+    Object args[PARALLEL_MAX_OPERANDS];
+    int depth;
+
+    atomic_bool done;
+    ParallelResultType result_type;
+    Object result;
+    int64_t result_int;
+    char message[sizeof(((ErrorHandler*) NULL)->message)];
+};
+
+static void* parallel_alloc(size_t size) {
+    void* ptr = malloc(size);
+    if (!ptr) {
+        error_and_die("cannot allocate memory");
+    }
+
+    return ptr;
+}
+
+static void collect_callees(Module* module, Expression* expression, bool* callees);
+
+static void collect_block_callees(Module* module, Block* block, bool* callees) {
+    for (int i = 0; i < block->children_size; i++) {
+        Statement* statement = &block->children[i];
+
+        switch (statement->type) {
+            case STMT_LETBLOCK:
+                for (int j = 0; j < statement->as.letblock.assignments_size; j++) {
+                    collect_callees(module, statement->as.letblock.assignments[j].expr, callees);
+                }
+                break;
+            case STMT_IF:
+                collect_callees(module, statement->as.ifstatement.expr, callees);
+                collect_block_callees(module, statement->as.ifstatement.true_block, callees);
+                collect_block_callees(module, statement->as.ifstatement.false_block, callees);
+                break;
+            case STMT_EXPRESSION:
+                collect_callees(module, statement->as.expression, callees);
+                break;
+        }
+    }
+}
+
+static void collect_callees(Module* module, Expression* expression, bool* callees) {
+    if (expression->type == EXPR_BINARY) {
+        collect_callees(module, expression->as.binary.lhs, callees);
+        collect_callees(module, expression->as.binary.rhs, callees);
+        return;
+    }
+
+    Value* value = &expression->as.primary;
+
+    switch (value->type) {
+        case VAL_FUNCALL: {
+            FunctionDeclaration* fun = module_find_fundecl(module, value->as.funcall.symbol);
+            if (fun) {
+                callees[fun - module->fundecls] = true;
+            }
+
+            for (int i = 0; i < value->as.funcall.args_size; i++) {
+                collect_callees(module, value->as.funcall.args[i], callees);
+            }
+            break;
+        }
+        case VAL_RECORD_CREATION:
+            for (int i = 0; i < value->as.record_creation.args_size; i++) {
+                collect_callees(module, value->as.record_creation.args[i], callees);
+            }
+            break;
+        case VAL_FIELD_ACCESS:
+            collect_callees(module, value->as.field_access.expr, callees);
+            break;
+        default:
+            break;
+    }
+}
+
+// a call is only worth a thread when it can recurse, everything else is too
+// small or bounded. marks the pure functions that reach a cycle of calls.
+static void find_forkable(Parallel* parallel) {
+    Module* module = parallel->module;
+    int size = module->fundecls_size;
+
+    bool* calls = parallel_alloc(sizeof(bool) * size * size + 1);
+    memset(calls, 0, sizeof(bool) * size * size);
+
+    for (int i = 0; i < size; i++) {
+        collect_block_callees(module, module->fundecls[i].block, &calls[i * size]);
+    }
+
+    // transitive closure, modules are small.
+    for (int k = 0; k < size; k++) {
+        for (int i = 0; i < size; i++) {
+            if (!calls[i * size + k])
+                continue;
+
+            for (int j = 0; j < size; j++) {
+                calls[i * size + j] |= calls[k * size + j];
+            }
+        }
+    }
+
+    for (int i = 0; i < size; i++) {
+        parallel->forkable[i] = false;
+
+        if (!module->fundecls[i].pure)
+            continue;
+
+        for (int j = 0; j < size; j++) {
+            if (calls[i * size + j] && calls[j * size + j]) {
+                parallel->forkable[i] = true;
+                break;
+            }
+        }
+    }
+
+    free(calls);
+}
+
+// expressions without calls, they cannot print and are cheap to evaluate.
+static bool expression_is_simple(Expression* expression) {
+    if (expression->type == EXPR_BINARY) {
+        return expression_is_simple(expression->as.binary.lhs) && expression_is_simple(expression->as.binary.rhs);
+    }
+
+    ValueType type = expression->as.primary.type;
+    return type == VAL_INT || type == VAL_FLOAT || type == VAL_IDENT;
+}
+
+static FunctionDeclaration* forkable_callee(Parallel* parallel, Expression* expression) {
+    if (expression->type != EXPR_PRIMARY || expression->as.primary.type != VAL_FUNCALL)
+        return NULL;
+
+    FunctionCall* funcall = &expression->as.primary.as.funcall;
+
+    FunctionDeclaration* fun = module_find_fundecl(parallel->module, funcall->symbol);
+    if (!fun || !parallel->forkable[fun - parallel->module->fundecls] || fun->args_size != funcall->args_size)
+        return NULL;
+
+    if (funcall->args_size > PARALLEL_MAX_OPERANDS)
+        return NULL;
+
+    for (int i = 0; i < funcall->args_size; i++) {
+        if (!expression_is_simple(funcall->args[i]))
+            return NULL;
+    }
+
+    return fun;
+}
+
+static void wake_sleepers(Parallel* parallel) {
+    if (atomic_load(&parallel->sleepers) > 0) {
+        pthread_mutex_lock(&parallel->lock);
+        pthread_cond_signal(&parallel->wake);
+        pthread_mutex_unlock(&parallel->lock);
+    }
+}
+
+static void push_task(ParallelWorker* worker, ParallelTask* task) {
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->tasks_size >= worker->tasks_cap) {
+        worker->tasks_cap = worker->tasks_cap ? worker->tasks_cap * 2 : 16;
+        worker->tasks = realloc(worker->tasks, sizeof(ParallelTask*) * worker->tasks_cap);
+        if (!worker->tasks) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    worker->tasks[worker->tasks_size++] = task;
+
+    pthread_mutex_unlock(&worker->lock);
+
+    atomic_fetch_add(&worker->parallel->available, 1);
+    wake_sleepers(worker->parallel);
+}
+
+// takes task back if no thief got it first. tasks are joined in reverse order
+// of forking, so an unstolen task is always the last one.
+static bool pop_task(ParallelWorker* worker, ParallelTask* task) {
+    bool popped = false;
+
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->tasks_size > worker->tasks_head && worker->tasks[worker->tasks_size - 1] == task) {
+        worker->tasks_size--;
+        popped = true;
+    }
+
+    if (worker->tasks_head == worker->tasks_size) {
+        worker->tasks_head = 0;
+        worker->tasks_size = 0;
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+
+    if (popped) {
+        atomic_fetch_sub(&worker->parallel->available, 1);
+    }
+
+    return popped;
+}
+
+static ParallelTask* steal_task(ParallelWorker* victim) {
+    ParallelTask* task = NULL;
+
+    pthread_mutex_lock(&victim->lock);
+
+    if (victim->tasks_size > victim->tasks_head) {
+        task = victim->tasks[victim->tasks_head++];
+
+        if (victim->tasks_head == victim->tasks_size) {
+            victim->tasks_head = 0;
+            victim->tasks_size = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&victim->lock);
+
+    if (task) {
+        atomic_fetch_sub(&victim->parallel->available, 1);
+    }
+
+    return task;
+}
+
+// tries every other worker once, starting at a random one.
+static ParallelTask* steal_any(ParallelWorker* worker) {
+    Parallel* parallel = worker->parallel;
+
+    if (atomic_load(&parallel->available) == 0)
+        return NULL;
+
+    // xorshift, only spreads the thieves over the victims.
+    worker->seed ^= worker->seed << 13;
+    worker->seed ^= worker->seed >> 7;
+    worker->seed ^= worker->seed << 17;
+
+    int start = worker->seed % parallel->workers_size;
+
+    for (int i = 0; i < parallel->workers_size; i++) {
+        ParallelWorker* victim = &parallel->workers[(start + i) % parallel->workers_size];
+        if (victim == worker)
+            continue;
+
+        ParallelTask* task = steal_task(victim);
+        if (task) {
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+static Object call_task(Interpreter* interpreter, ParallelTask* task) {
+    FunctionDeclaration* fundecl = task->fundecl;
+
+    Scope scope = interpreter_push_frame(interpreter, fundecl->slots_size);
+    memcpy(&SLOT(&scope, 0), task->args, sizeof(Object) * fundecl->args_size);
+
+    interpreter->stats.calls++;
+
+    Object result = execute_function_declaration(interpreter, fundecl, &scope);
+    interpreter_pop_frame(interpreter, &scope);
+
+    return result;
+}
+
+// calls the task catching what it raises into its message, so the owner can
+// raise it at the join in the order the calls would have been made.
+static bool try_call_task(Interpreter* interpreter, ParallelTask* task, Object* result) {
+    ErrorHandler handler;
+    handler.previous = error_handler;
+
+    int frames_size = interpreter->frames_size;
+
+    if (setjmp(handler.jump)) {
+        error_handler = handler.previous;
+        interpreter->frames_size = frames_size;
+        memcpy(task->message, handler.message, sizeof(task->message));
+        return false;
+    }
+
+    error_handler = &handler;
+    *result = call_task(interpreter, task);
+    error_handler = handler.previous;
+
+    return true;
+}
+
+// the same for an operand evaluated by the owner.
+static bool try_evaluate(Interpreter* interpreter, Expression* expression, Scope* scope, Object* result, char* message) {
+    ErrorHandler handler;
+    handler.previous = error_handler;
+
+    int frames_size = interpreter->frames_size;
+
+    if (setjmp(handler.jump)) {
+        error_handler = handler.previous;
+        interpreter->frames_size = frames_size;
+        memcpy(message, handler.message, sizeof(handler.message));
+        return false;
+    }
+
+    error_handler = &handler;
+    *result = execute_expression(interpreter, expression, scope);
+    error_handler = handler.previous;
+
+    return true;
+}
+
+// runs a task forked by another worker, only numbers can leave this heap.
+static void run_stolen(ParallelWorker* worker, ParallelTask* task) {
+    int depth = worker->depth;
+    worker->depth = task->depth;
+
+    Object result;
+    bool called = try_call_task(worker->interpreter, task, &result);
+
+    worker->depth = depth;
+
+    if (!called) {
+        task->result_type = RESULT_FAILED;
+    } else if (object_is_small_int(result) || object_is_float(result)) {
+        task->result_type = RESULT_OBJECT;
+        task->result = result;
+    } else if (object_is_boxed_int(result)) {
+        task->result_type = RESULT_INT;
+        task->result_int = object_as_int(result);
+    } else {
+        task->result_type = RESULT_UNMOVABLE;
+    }
+
+    worker->stats.steals++;
+
+    atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+// helps the others while the thief finishes.
+static void wait_task(ParallelWorker* worker, ParallelTask* task) {
+    while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+        ParallelTask* other = steal_any(worker);
+        if (other) {
+            run_stolen(worker, other);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+// false when the call failed, with the error in the task's message.
+static bool join_task(ParallelWorker* worker, ParallelTask* task, Object* result) {
+    Interpreter* interpreter = worker->interpreter;
+
+    if (pop_task(worker, task)) {
+        return try_call_task(interpreter, task, result);
+    }
+
+    wait_task(worker, task);
+
+    switch (task->result_type) {
+        case RESULT_OBJECT:
+            *result = task->result;
+            return true;
+        case RESULT_INT:
+            *result = heap_make_int(&interpreter->heap, task->result_int);
+            return true;
+        case RESULT_FAILED:
+            return false;
+        case RESULT_UNMOVABLE:
+            break;
+    }
+
+    worker->stats.reruns++;
+
+    return try_call_task(interpreter, task, result);
+}
+
+// a task whose result is not needed anymore, it still has to leave the deque
+// and the thief before the frame holding it is gone.
+static void drop_task(ParallelWorker* worker, ParallelTask* task) {
+    if (!pop_task(worker, task)) {
+        wait_task(worker, task);
+    }
+}
+
+// every operand has to be either simple or a forkable call, nothing observable
+// happens in between so the order they finish in does not matter.
+static bool plan_forks(ParallelWorker* worker, Expression** expressions, int expressions_size, FunctionDeclaration** callees) {
+    if (worker->depth >= PARALLEL_MAX_DEPTH || expressions_size > PARALLEL_MAX_OPERANDS)
+        return false;
+
+    int forks = 0;
+
+    for (int i = 0; i < expressions_size; i++) {
+        callees[i] = forkable_callee(worker->parallel, expressions[i]);
+
+        if (callees[i]) {
+            forks++;
+        } else if (!expression_is_simple(expressions[i])) {
+            return false;
+        }
+    }
+
+    return forks >= 2;
+}
+
+// errors are caught per operand and the one of the leftmost failing operand is
+// raised once every fork is joined, which is the error running them in order
+// would raise, whoever finished first.
+static void run_forks(Interpreter* interpreter, Expression** expressions, int expressions_size, FunctionDeclaration** callees, Scope* scope, Scope* dest) {
+    ParallelWorker* worker = interpreter->worker;
+
+    ParallelTask tasks[PARALLEL_MAX_OPERANDS];
+    bool forked[PARALLEL_MAX_OPERANDS];
+
+    // operands from failed on are not needed anymore.
+    int failed = expressions_size;
+    char message[sizeof(((ErrorHandler*) NULL)->message)];
+
+    worker->depth++;
+
+    // the first call stays with this worker, the others are offered to the pool.
+    bool first = true;
+    for (int i = 0; i < expressions_size; i++) {
+        forked[i] = false;
+
+        if (!callees[i] || failed < expressions_size)
+            continue;
+
+        if (first) {
+            first = false;
+            continue;
+        }
+
+        FunctionCall* funcall = &expressions[i]->as.primary.as.funcall;
+        ParallelTask* task = &tasks[i];
+
+        bool movable = true;
+        for (int j = 0; j < funcall->args_size; j++) {
+            if (!try_evaluate(interpreter, funcall->args[j], scope, &task->args[j], message)) {
+                failed = i;
+                movable = false;
+                break;
+            }
+
+            // boxed ints belong to this heap.
+            if (!object_is_small_int(task->args[j]) && !object_is_float(task->args[j])) {
+                movable = false;
+                break;
+            }
+        }
+
+        if (!movable)
+            continue;
+
+        task->fundecl = callees[i];
+        task->depth = worker->depth;
+        atomic_init(&task->done, false);
+
+        push_task(worker, task);
+        forked[i] = true;
+        worker->stats.forks++;
+    }
+
+    for (int i = 0; i < failed; i++) {
+        if (!forked[i]) {
+            Object object;
+            if (!try_evaluate(interpreter, expressions[i], scope, &object, message)) {
+                failed = i;
+                break;
+            }
+
+            SLOT(dest, i) = object;
+        }
+    }
+
+    for (int i = expressions_size - 1; i >= 0; i--) {
+        if (!forked[i])
+            continue;
+
+        if (i > failed) {
+            drop_task(worker, &tasks[i]);
+            continue;
+        }
+
+        Object object;
+        if (!join_task(worker, &tasks[i], &object)) {
+            failed = i;
+            memcpy(message, tasks[i].message, sizeof(message));
+            continue;
+        }
+
+        SLOT(dest, i) = object;
+    }
+
+    worker->depth--;
+
+    if (failed < expressions_size) {
+        error_and_die("%s", message);
+    }
+}
+
+bool parallel_evaluate(Interpreter* interpreter, Expression** expressions, int expressions_size, Scope* scope, Scope* dest) {
+    FunctionDeclaration* callees[PARALLEL_MAX_OPERANDS];
+
+    if (!plan_forks(interpreter->worker, expressions, expressions_size, callees))
+        return false;
+
+    run_forks(interpreter, expressions, expressions_size, callees, scope, dest);
+
+    return true;
+}
+
+bool parallel_binary(Interpreter* interpreter, BinaryExpression* binary, Scope* scope, Object* result) {
+    Expression* operands[2] = { binary->lhs, binary->rhs };
+    FunctionDeclaration* callees[2];
+
+    if (!plan_forks(interpreter->worker, operands, 2, callees))
+        return false;
+
+    // the operands stay reachable while the other one is joined.
+    Scope temp = interpreter_push_frame(interpreter, 2);
+    run_forks(interpreter, operands, 2, callees, scope, &temp);
+
+    Object lhs = SLOT(&temp, 0);
+    Object rhs = SLOT(&temp, 1);
+    interpreter_pop_frame(interpreter, &temp);
+
+    *result = perform_binary(&interpreter->heap, binary->type, lhs, rhs);
+
+    return true;
+}
+
+static void* worker_main(void* context) {
+    ParallelWorker* worker = context;
+    Parallel* parallel = worker->parallel;
+
+    int misses = 0;
+
+    while (!atomic_load(&parallel->shutdown)) {
+        ParallelTask* task = steal_any(worker);
+        if (task) {
+            run_stolen(worker, task);
+            misses = 0;
+            continue;
+        }
+
+        if (++misses < PARALLEL_SPINS) {
+            sched_yield();
+            continue;
+        }
+
+        misses = 0;
+
+        // a pusher bumps available before looking for sleepers, and we register
+        // before looking at available, so one of us always sees the other.
+        pthread_mutex_lock(&parallel->lock);
+        atomic_fetch_add(&parallel->sleepers, 1);
+
+        while (!atomic_load(&parallel->shutdown) && atomic_load(&parallel->available) == 0) {
+            pthread_cond_wait(&parallel->wake, &parallel->lock);
+        }
+
+        atomic_fetch_sub(&parallel->sleepers, 1);
+        pthread_mutex_unlock(&parallel->lock);
+    }
+
+    return NULL;
+}
+
+void parallel_init(Parallel* parallel, Interpreter* interpreter, int threads) {
+    assert(parallel != NULL);
+    assert(interpreter != NULL);
+    assert(threads > 0);
+
+    Module* module = interpreter->module;
+
+    parallel->module = module;
+
+    parallel->forkable = parallel_alloc(sizeof(bool) * (module->fundecls_size + 1));
+    find_forkable(parallel);
+
+    pthread_mutex_init(&parallel->lock, NULL);
+    pthread_cond_init(&parallel->wake, NULL);
+    atomic_init(&parallel->available, 0);
+    atomic_init(&parallel->sleepers, 0);
+    atomic_init(&parallel->shutdown, false);
+
+    parallel->workers = parallel_alloc(sizeof(ParallelWorker) * threads);
+    parallel->workers_size = threads;
+
+    for (int i = 0; i < threads; i++) {
+        ParallelWorker* worker = &parallel->workers[i];
+
+        worker->parallel = parallel;
+        worker->index = i;
+
+        if (i == 0) {
+            worker->interpreter = interpreter;
+        } else {
+            interpreter_init(&worker->own, module);
+            worker->own.heap.limit = interpreter->heap.limit;
+            worker->own.heap.stress = interpreter->heap.stress;
+
+            worker->interpreter = &worker->own;
+        }
+
+        worker->interpreter->worker = worker;
+        worker->interpreter->shared = true;
+
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->tasks = NULL;
+        worker->tasks_head = 0;
+        worker->tasks_size = 0;
+        worker->tasks_cap = 0;
+
+        worker->depth = 0;
+        worker->seed = 0x9e3779b97f4a7c15u * (i + 1);
+
+        worker->stats = (ParallelStats) {0};
+    }
+
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&parallel->workers[i].thread, NULL, worker_main, &parallel->workers[i]) != 0) {
+            error_and_die("cannot start thread");
+        }
+    }
+}
+
+void parallel_deinit(Parallel* parallel) {
+    assert(parallel != NULL);
+
+    pthread_mutex_lock(&parallel->lock);
+    atomic_store(&parallel->shutdown, true);
+    pthread_cond_broadcast(&parallel->wake);
+    pthread_mutex_unlock(&parallel->lock);
+
+    for (int i = 1; i < parallel->workers_size; i++) {
+        pthread_join(parallel->workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < parallel->workers_size; i++) {
+        ParallelWorker* worker = &parallel->workers[i];
+
+        if (i > 0) {
+            interpreter_deinit(&worker->own);
+        }
+
+        worker->interpreter->worker = NULL;
+        worker->interpreter->shared = false;
+
+        pthread_mutex_destroy(&worker->lock);
+        free(worker->tasks);
+    }
+
+    pthread_mutex_destroy(&parallel->lock);
+    pthread_cond_destroy(&parallel->wake);
+
+    free(parallel->workers);
+    free(parallel->forkable);
+}
+
+ParallelStats parallel_stats(Parallel* parallel) {
+    ParallelStats stats = {0};
+
+    for (int i = 0; i < parallel->workers_size; i++) {
+        stats.forks += parallel->workers[i].stats.forks;
+        stats.steals += parallel->workers[i].stats.steals;
+        stats.reruns += parallel->workers[i].stats.reruns;
+    }
+
+    return stats;
+}
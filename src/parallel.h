@@ -0,0 +1,78 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "ast.h"
+#include "interpreter.h"
+
+typedef struct ParallelTask_t ParallelTask;
+
+typedef struct {
+    long forks;  // calls handed to the pool
+    long steals; // forked calls another thread ran
+    long reruns; // stolen calls whose result could not cross heaps, run again by the owner
+} ParallelStats;
+
+// a thread of the pool with its own interpreter, frames and heap. the module is
+// shared, tasks only move numbers between threads.
+struct ParallelWorker_t {
+    Parallel* parallel;
+    int index;
+
+    Interpreter* interpreter;
+    Interpreter own; // unused by the first worker, which runs on the main interpreter
+
+    pthread_t thread;
+
+    // forked tasks, the owner pushes and pops at the end, thieves take from head.
+    pthread_mutex_t lock;
+    ParallelTask** tasks;
+    int tasks_head;
+    int tasks_size;
+    int tasks_cap;
+
+    int depth; // forks enclosing what the worker runs now
+    uint64_t seed;
+
+    ParallelStats stats;
+};
+
+// work stealing pool evaluating independent calls of pure functions at once.
+struct Parallel_t {
+    Module* module;
+
+    ParallelWorker* workers;
+    int workers_size;
+
+    // per function declaration, pure and reaching a recursive function, worth a fork.
+    bool* forkable;
+
+    // idle workers sleep until a task shows up.
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    atomic_int available;
+    atomic_int sleepers;
+    atomic_bool shutdown;
+};
+
+// forks stop below this many nested forks, deeper calls are too small to pay off.
+#define PARALLEL_MAX_DEPTH 10
+
+// at most this many operands of one node are evaluated in parallel.
+#define PARALLEL_MAX_OPERANDS 8
+
+// interpreter becomes the first worker, threads - 1 more are started.
+void parallel_init(Parallel* parallel, Interpreter* interpreter, int threads);
+void parallel_deinit(Parallel* parallel);
+
+ParallelStats parallel_stats(Parallel* parallel);
+
+// evaluates the expressions into the first slots of dest, running the calls among
+// them on other threads when every one is free of effects. returns false, having
+// evaluated nothing, when they are better evaluated in order.
+bool parallel_evaluate(Interpreter* interpreter, Expression** expressions, int expressions_size, Scope* scope, Scope* dest);
+
+// the same for both operands of a binary expression, which is then performed.
+bool parallel_binary(Interpreter* interpreter, BinaryExpression* binary, Scope* scope, Object* result);
@@ -1,31 +1,54 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "parser.h"
 
-static bool parser_eof(Parser* parser) {
-    return parser->cursor >= parser->tokens_size;
+// spans are not zero terminated, the source may be mapped straight from the file.
+// returns the literal as a string, in buffer when it fits.
+static char* literal_text(Span span, char* buffer, int buffer_size) {
+    char* text = span.size < buffer_size ? buffer : malloc(span.size + 1);
+    if (!text) {
+        error_and_die("cannot allocate memory");
+    }
+
+    memcpy(text, span.data, span.size);
+    text[span.size] = 0;
+
+    return text;
 }
 
-static Token* current_token(Parser* parser) {
-    if (parser_eof(parser))
-        return NULL;
+static bool parser_eof(Parser* parser) {
+    return parser->cursor >= parser->tokens->size;
+}
 
-    return &parser->tokens[parser->cursor];
+// TOK_EOF past the last token.
+static Token current_token(Parser* parser) {
+    return tokens_get(parser->tokens, parser->cursor);
 }
 
 static bool expect(Parser* parser, TokenType type) {
-    if (!current_token(parser))
-        return false;
+    return current_token(parser).type == type;
+}
+
+// the grammar looks a single token ahead, so the window is only refilled once
+// the last token in it is consumed.
+static void fill(Parser* parser) {
+    if (parser->lexer && parser->cursor >= parser->tokens->size) {
+        parser->tokens->size = 0;
+        parser->cursor = 0;
 
-    return current_token(parser)->type == type;
+        lexer_fill(parser->lexer, parser->tokens);
+    }
 }
 
 static void advance(Parser* parser) {
-    if (!parser_eof(parser))
+    if (!parser_eof(parser)) {
         parser->cursor++;
+        fill(parser);
+    }
 }
 
 static void match(Parser* parser, TokenType type) {
@@ -33,7 +56,12 @@ static void match(Parser* parser, TokenType type) {
         if (parser_eof(parser)) {
             error_and_die("unexpected end of file");
         } else {
-            error_and_die("expected: %d but got: ", type, SPAN_FMT, SPAN_ARG(current_token(parser)->span));
+            Span span = current_token(parser).span;
+
+            int line, col;
+            tokens_position(parser->tokens, span.data, &line, &col);
+
+            error_and_die("[%d:%d] expected: %d but got: "SPAN_FMT, line, col, type, SPAN_ARG(span));
         }
     }
 
@@ -41,10 +69,7 @@ static void match(Parser* parser, TokenType type) {
 }
 
 static bool expect_comparison(Parser* parser) {
-    if (!current_token(parser))
-        return false;
-
-    switch (current_token(parser)->type) {
+    switch (current_token(parser).type) {
         case TOK_EQUALEQUAL:
         case TOK_NOTEQUAL:
         case TOK_GREATEREQUAL:
@@ -57,20 +82,39 @@ static bool expect_comparison(Parser* parser) {
     }
 }
 
-void parser_init(Parser* parser, Token* tokens, int tokens_size) {
+void parser_init(Parser* parser, Arena* arena, Lexer* lexer) {
+    parser->arena = arena;
+    parser->lexer = lexer;
+
+    tokens_init(&parser->window, lexer->start, lexer->end - lexer->start);
+    tokens_grow(&parser->window, PARSER_WINDOW);
+
+    parser->tokens = &parser->window;
+    parser->cursor = 0;
+
+    fill(parser);
+}
+
+void parser_init_tokens(Parser* parser, Arena* arena, Tokens* tokens) {
+    parser->arena = arena;
+    parser->lexer = NULL;
+    parser->window = (Tokens) {0};
+
     parser->tokens = tokens;
-    parser->tokens_size = tokens_size;
     parser->cursor = 0;
 }
 
 void parser_deinit(Parser* parser) {
-    free(parser->tokens);
+    // the tree only keeps spans into the source, no token outlives parsing.
+    tokens_free(&parser->window);
+
+    parser->arena = NULL;
+    parser->lexer = NULL;
     parser->tokens = NULL;
-    parser->tokens_size = 0;
     parser->cursor = 0;
 }
 
-Expression* parse_primary(Parser* parser) {
+static Expression* parse_operand(Parser* parser) {
     if (parser_eof(parser)) {
         error_and_die("unexpected end of file");
     }
@@ -84,33 +128,47 @@ Expression* parse_primary(Parser* parser) {
 
         return expr;
     } else if (expect(parser, TOK_INTLITERAL)) {
+        char buffer[64];
+        char* text = literal_text(current_token(parser).span, buffer, sizeof(buffer));
+
         Value value = {
             .type = VAL_INT,
-            .as.integer = strtoll(current_token(parser)->span.data, NULL, 10),
+            .as.integer = strtoll(text, NULL, 10),
         };
 
+        if (text != buffer) {
+            free(text);
+        }
+
         advance(parser);
 
-        Expression* expr = expression_make();
+        Expression* expr = expression_make(parser->arena);
         expr->type = EXPR_PRIMARY;
         expr->as.primary = value;
 
         return expr;
     } else if (expect(parser, TOK_FLOATLITERAL)) {
+        char buffer[64];
+        char* text = literal_text(current_token(parser).span, buffer, sizeof(buffer));
+
         Value value = {
             .type = VAL_FLOAT,
-            .as.floating = strtod(current_token(parser)->span.data, NULL),
+            .as.floating = strtod(text, NULL),
         };
 
+        if (text != buffer) {
+            free(text);
+        }
+
         advance(parser);
 
-        Expression* expr = expression_make();
+        Expression* expr = expression_make(parser->arena);
         expr->type = EXPR_PRIMARY;
         expr->as.primary = value;
 
         return expr;
     } else if (expect(parser, TOK_IDENTIFIER)) {
-        Token* id = current_token(parser);
+        Token id = current_token(parser);
         advance(parser);
 
         if (expect(parser, TOK_LSBRACE)) {
@@ -128,13 +186,7 @@ Expression* parse_primary(Parser* parser) {
 
                 Expression* expression = parse_expression(parser);
 
-                if (!args) {
-                    args_cap = 1;
-                    args = malloc(sizeof(Expression*));
-                } else {
-                    args_cap++;
-                    args = realloc(args, sizeof(Expression*) * args_cap);
-                }
+                args = arena_reserve(parser->arena, args, args_size, &args_cap, sizeof(Expression*));
 
                 args[args_size++] = expression;
 
@@ -144,7 +196,8 @@ Expression* parse_primary(Parser* parser) {
             match(parser, TOK_RSBRACE);
 
             FunctionCall funcall = {
-                .id = id->span,
+                .id = id.span,
+                .symbol = id.symbol,
                 .args = args,
                 .args_size = args_size,
                 .args_cap = args_cap,
@@ -155,7 +208,7 @@ Expression* parse_primary(Parser* parser) {
                 .as.funcall = funcall,
             };
 
-            Expression* expr = expression_make();
+            Expression* expr = expression_make(parser->arena);
             expr->type = EXPR_PRIMARY;
             expr->as.primary = value;
 
@@ -163,10 +216,14 @@ Expression* parse_primary(Parser* parser) {
         } else {
             Value value = {
                 .type = VAL_IDENT,
-                .as.identifier = id->span,
+                .as.identifier = (Identifier) {
+                    .id = id.span,
+                    .symbol = id.symbol,
+                    .slot = -1,
+                },
             };
 
-            Expression* expr = expression_make();
+            Expression* expr = expression_make(parser->arena);
             expr->type = EXPR_PRIMARY;
             expr->as.primary = value;
 
@@ -175,7 +232,7 @@ Expression* parse_primary(Parser* parser) {
     } else {
         RecordCreation record_creation = parse_record_creation(parser);
 
-        Expression* expr = expression_make();
+        Expression* expr = expression_make(parser->arena);
         expr->type = EXPR_PRIMARY;
         expr->as.primary = (Value) {
             .type = VAL_RECORD_CREATION,
@@ -185,19 +242,52 @@ Expression* parse_primary(Parser* parser) {
         return expr;
     }
 
-    error_and_die("unexpected token: "SPAN_FMT, SPAN_ARG(current_token(parser)->span));
+    Span span = current_token(parser).span;
+
+    int line, col;
+    tokens_position(parser->tokens, span.data, &line, &col);
+
+    error_and_die("[%d:%d] unexpected token: "SPAN_FMT, line, col, SPAN_ARG(span));
+}
+
+Expression* parse_primary(Parser* parser) {
+    Expression* expr = parse_operand(parser);
+
+    while (expect(parser, TOK_DOT)) {
+        advance(parser);
+
+        Token field = current_token(parser);
+        match(parser, TOK_IDENTIFIER);
+
+        Expression* access = expression_make(parser->arena);
+        access->type = EXPR_PRIMARY;
+        access->as.primary = (Value) {
+            .type = VAL_FIELD_ACCESS,
+            .as.field_access = (FieldAccess) {
+                .expr = expr,
+                .field = field.span,
+                .symbol = field.symbol,
+                .cached_shape = NULL,
+                .cached_offset = -1,
+            },
+        };
+
+        expr = access;
+    }
+
+    return expr;
 }
 
 Expression* parse_factor(Parser* parser) {
     Expression* lhs = parse_primary(parser);
 
     while (expect(parser, TOK_STAR) || expect(parser, TOK_SLASH)) {
-        BinaryExpressionType type = (current_token(parser)->type == TOK_STAR ? BIN_MUL : BIN_DIV);
+        BinaryExpressionType type = (current_token(parser).type == TOK_STAR ? BIN_MUL : BIN_DIV);
         advance(parser);
 
         Expression* rhs = parse_primary(parser);
 
-        Expression* binary = expression_make();
+        Expression* binary = expression_make(parser->arena);
         binary->type = EXPR_BINARY;
         binary->as.binary = binary_expression_make(type, lhs, rhs);
 
@@ -211,12 +301,12 @@ Expression* parse_term(Parser* parser) {
     Expression* lhs = parse_factor(parser);
 
     while (expect(parser, TOK_PLUS) || expect(parser, TOK_MINUS)) {
-        BinaryExpressionType type = (current_token(parser)->type == TOK_PLUS ? BIN_ADD : BIN_SUB);
+        BinaryExpressionType type = (current_token(parser).type == TOK_PLUS ? BIN_ADD : BIN_SUB);
         advance(parser);
 
         Expression* rhs = parse_factor(parser);
 
-        Expression* binary = expression_make();
+        Expression* binary = expression_make(parser->arena);
         binary->type = EXPR_BINARY;
         binary->as.binary = binary_expression_make(type, lhs, rhs);
 
@@ -232,7 +322,7 @@ Expression* parse_expression(Parser* parser) {
     while (expect_comparison(parser)) {
         BinaryExpressionType type;
 
-        switch (current_token(parser)->type) {
+        switch (current_token(parser).type) {
             case TOK_EQUALEQUAL:
                 type = BIN_EQU;
                 break;
@@ -258,14 +348,14 @@ Expression* parse_expression(Parser* parser) {
                 type = BIN_OR;
                 break;
             default:
-                break;
+                error_and_die("unreachable");
         }
 
         advance(parser);
 
         Expression* rhs = parse_term(parser);
 
-        Expression* binary = expression_make();
+        Expression* binary = expression_make(parser->arena);
         binary->type = EXPR_BINARY;
         binary->as.binary = binary_expression_make(type, lhs, rhs);
 
@@ -276,7 +366,7 @@ Expression* parse_expression(Parser* parser) {
 }
 
 Assignment parse_assignment(Parser* parser) {
-    Token* id = current_token(parser);
+    Token id = current_token(parser);
     match(parser, TOK_IDENTIFIER);
 
     match(parser, TOK_ARROW);
@@ -284,7 +374,9 @@ Assignment parse_assignment(Parser* parser) {
     Expression* expr = parse_expression(parser);
 
     return (Assignment) {
-        .id = id->span,
+        .id = id.span,
+        .symbol = id.symbol,
+        .slot = -1,
         .expr = expr,
     };
 }
@@ -292,18 +384,12 @@ Assignment parse_assignment(Parser* parser) {
 Block* parse_block(Parser* parser) {
     match(parser, TOK_LCBRACE);
 
-    Block* block = block_make();
+    Block* block = block_make(parser->arena);
 
     while (!parser_eof(parser) && !expect(parser, TOK_RCBRACE)) {
         Statement statement = parse_statement(parser);
 
-        if (!block->children) {
-            block->children_cap = 1;
-            block->children = malloc(sizeof(Statement));
-        } else {
-            block->children_cap++;
-            block->children = realloc(block->children, sizeof(Statement) * block->children_cap);
-        }
+        block->children = arena_reserve(parser->arena, block->children, block->children_size, &block->children_cap, sizeof(Statement));
 
         block->children[block->children_size++] = statement;
     }
@@ -318,7 +404,7 @@ LetBlock parse_let_block(Parser* parser) {
 
     match(parser, TOK_LSBRACE);
 
-    Span* ids = NULL;
+    Identifier* ids = NULL;
     int ids_size = 0;
     int ids_cap = 0;
 
@@ -328,18 +414,16 @@ LetBlock parse_let_block(Parser* parser) {
             match(parser, TOK_COMMA);
         }
 
-        Token* id = current_token(parser);
+        Token id = current_token(parser);
         match(parser, TOK_IDENTIFIER);
 
-        if (!ids) {
-            ids_cap = 1;
-            ids = malloc(sizeof(Span));
-        } else {
-            ids_cap++;
-            ids = realloc(ids, sizeof(Span) * ids_cap);
-        }
+        ids = arena_reserve(parser->arena, ids, ids_size, &ids_cap, sizeof(Identifier));
 
-        ids[ids_size++] = id->span;
+        ids[ids_size++] = (Identifier) {
+            .id = id.span,
+            .symbol = id.symbol,
+            .slot = -1,
+        };
 
         first = false;
     }
@@ -366,13 +450,7 @@ LetBlock parse_let_block(Parser* parser) {
 
         Assignment assignment = parse_assignment(parser);
 
-        if (!ids) {
-            assignments_cap = 1;
-            assignments = malloc(sizeof(Assignment));
-        } else {
-            assignments_cap++;
-            assignments = realloc(assignments, sizeof(Assignment) * assignments_cap);
-        }
+        assignments = arena_reserve(parser->arena, assignments, assignments_size, &assignments_cap, sizeof(Assignment));
 
         assignments[assignments_size++] = assignment;
 
@@ -434,12 +512,12 @@ Statement parse_statement(Parser* parser) {
 FunctionDeclaration parse_function_declaration(Parser* parser) {
     match(parser, TOK_DEF);
 
-    Token* id = current_token(parser);
+    Token id = current_token(parser);
     match(parser, TOK_IDENTIFIER);
 
     match(parser, TOK_LSBRACE);
 
-    Span* args = NULL;
+    Identifier* args = NULL;
     int args_size = 0;
     int args_cap = 0;
 
@@ -449,18 +527,17 @@ FunctionDeclaration parse_function_declaration(Parser* parser) {
             match(parser, TOK_COMMA);
         }
 
-        Token* arg = current_token(parser);
+        Token arg = current_token(parser);
         match(parser, TOK_IDENTIFIER);
 
-        if (!args) {
-            args_cap = 1;
-            args = malloc(sizeof(Span));
-        } else {
-            args_cap++;
-            args = realloc(args, sizeof(Span) * args_cap);
-        }
+        args = arena_reserve(parser->arena, args, args_size, &args_cap, sizeof(Identifier));
 
-        args[args_size++] = arg->span;
+        args[args_size] = (Identifier) {
+            .id = arg.span,
+            .symbol = arg.symbol,
+            .slot = args_size,
+        };
+        args_size++;
 
         first = false;
     }
@@ -472,10 +549,12 @@ FunctionDeclaration parse_function_declaration(Parser* parser) {
     Block* block = parse_block(parser);
 
     return (FunctionDeclaration) {
-        .id = id->span,
+        .id = id.span,
+        .symbol = id.symbol,
         .args = args,
         .args_size = args_size,
         .args_cap = args_cap,
+        .slots_size = args_size,
         .block = block,
     };
 }
@@ -483,12 +562,12 @@ FunctionDeclaration parse_function_declaration(Parser* parser) {
 Record parse_record(Parser* parser) {
     match(parser, TOK_RECORD);
 
-    Token* id = current_token(parser);
+    Token id = current_token(parser);
     match(parser, TOK_IDENTIFIER);
 
     match(parser, TOK_LCBRACE);
 
-    Span* fields = NULL;
+    Identifier* fields = NULL;
     int fields_size = 0;
     int fields_cap = 0;
 
@@ -498,18 +577,17 @@ Record parse_record(Parser* parser) {
             match(parser, TOK_COMMA);
         }
 
-        Token* field = current_token(parser);
+        Token field = current_token(parser);
         match(parser, TOK_IDENTIFIER);
 
-        if (!fields) {
-            fields_cap = 1;
-            fields = malloc(sizeof(Span));
-        } else {
-            fields_cap++;
-            fields = realloc(fields, sizeof(Span) * fields_cap);
-        }
+        fields = arena_reserve(parser->arena, fields, fields_size, &fields_cap, sizeof(Identifier));
 
-        fields[fields_size++] = field->span;
+        fields[fields_size] = (Identifier) {
+            .id = field.span,
+            .symbol = field.symbol,
+            .slot = fields_size,
+        };
+        fields_size++;
 
         first = false;
     }
@@ -521,7 +599,8 @@ Record parse_record(Parser* parser) {
     }
 
     return (Record) {
-        .id = id->span,
+        .id = id.span,
+        .symbol = id.symbol,
         .fields = fields,
         .fields_size = fields_size,
         .fields_cap = fields_cap,
@@ -531,7 +610,7 @@ Record parse_record(Parser* parser) {
 RecordCreation parse_record_creation(Parser* parser) {
     match(parser, TOK_RECORD);
 
-    Token* id = current_token(parser);
+    Token id = current_token(parser);
     match(parser, TOK_IDENTIFIER);
 
     match(parser, TOK_LCBRACE);
@@ -548,13 +627,7 @@ RecordCreation parse_record_creation(Parser* parser) {
 
         Expression* expression = parse_expression(parser);
 
-        if (!args) {
-            args_cap = 1;
-            args = malloc(sizeof(Expression*));
-        } else {
-            args_cap++;
-            args = realloc(args, sizeof(Expression*) * args_cap);
-        }
+        args = arena_reserve(parser->arena, args, args_size, &args_cap, sizeof(Expression*));
 
         args[args_size++] = expression;
 
@@ -564,7 +637,8 @@ RecordCreation parse_record_creation(Parser* parser) {
     match(parser, TOK_RCBRACE);
 
     return (RecordCreation) {
-        .id = id->span,
+        .id = id.span,
+        .symbol = id.symbol,
         .args = args,
         .args_size = args_size,
         .args_cap = args_cap,
@@ -584,25 +658,13 @@ Module parse_module(Parser* parser) {
         if (expect(parser, TOK_RECORD)) {
             Record record = parse_record(parser);
 
-            if (!records) {
-                records_cap = 1;
-                records = malloc(sizeof(Record));
-            } else {
-                records_cap++;
-                records = realloc(records, sizeof(Record) * records_cap);
-            }
+            records = arena_reserve(parser->arena, records, records_size, &records_cap, sizeof(Record));
 
             records[records_size++] = record;
         } else if (expect(parser, TOK_DEF)) {
             FunctionDeclaration fundecl = parse_function_declaration(parser);
 
-            if (!fundecls) {
-                fundecls_cap = 1;
-                fundecls = malloc(sizeof(FunctionDeclaration));
-            } else {
-                fundecls_cap++;
-                fundecls = realloc(fundecls, sizeof(FunctionDeclaration) * fundecls_cap);
-            }
+            fundecls = arena_reserve(parser->arena, fundecls, fundecls_size, &fundecls_cap, sizeof(FunctionDeclaration));
 
             fundecls[fundecls_size++] = fundecl;
         } else {
@@ -610,7 +672,8 @@ Module parse_module(Parser* parser) {
         }
     }
 
-    return (Module) {
+    Module module = {
+        .arena = parser->arena,
         .records = records,
         .records_size = records_size,
         .records_cap = records_cap,
@@ -618,4 +681,6 @@ Module parse_module(Parser* parser) {
         .fundecls_size = fundecls_size,
         .fundecls_cap = fundecls_cap,
     };
+
+    return module;
 }
@@ -1,15 +1,30 @@
 #pragma once
 
 #include "ast.h"
+#include "lexer.h"
 #include "token.h"
 
+// tokens pulled from the lexer at a time, lexing and parsing take turns.
+#define PARSER_WINDOW 256
+
 typedef struct {
-    Token* tokens;
-    int tokens_size;
+    Arena* arena;
+
+    // when streaming, tokens points at window and the lexer refills it whenever
+    // the parser has read it all, otherwise at tokens lexed beforehand.
+    Lexer* lexer;
+    Tokens window;
+
+    Tokens* tokens;
     int cursor;
 } Parser;
 
-void parser_init(Parser* parser, Token* tokens, int tokens_size);
+// pulls tokens from lexer as parsing goes, never holding more than a window of them.
+void parser_init(Parser* parser, Arena* arena, Lexer* lexer);
+
+// reads tokens lexed beforehand, which belong to the caller.
+void parser_init_tokens(Parser* parser, Arena* arena, Tokens* tokens);
+
 void parser_deinit(Parser* parser);
 
 Expression* parse_primary(Parser* parser);
@@ -0,0 +1,196 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "object.h"
+#include "resolver.h"
+
+static void declare(Resolver* resolver, Symbol symbol, int slot) {
+    if (resolver->bindings_size >= resolver->bindings_cap) {
+        resolver->bindings_cap = resolver->bindings_cap ? resolver->bindings_cap * 2 : 16;
+        resolver->bindings = realloc(resolver->bindings, sizeof(Binding) * resolver->bindings_cap);
+        if (!resolver->bindings) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    resolver->bindings[resolver->bindings_size++] = (Binding) {
+        .symbol = symbol,
+        .slot = slot,
+    };
+}
+
+static int lookup(Resolver* resolver, Symbol symbol, Span id) {
+    // the most recent binding shadows the older ones.
+    for (int i = resolver->bindings_size - 1; i >= 0; i--) {
+        if (resolver->bindings[i].symbol == symbol) {
+            return resolver->bindings[i].slot;
+        }
+    }
+
+    error_and_die("no such variable: "SPAN_FMT, SPAN_ARG(id));
+}
+
+static void index_fields(Resolver* resolver) {
+    Module* module = resolver->module;
+
+    for (int i = 0; i < module->records_size; i++) {
+        Record* record = &module->records[i];
+
+        for (int j = 0; j < record->fields_size; j++) {
+            Symbol field = record->fields[j].symbol;
+
+            if (!symbol_map_insert(&resolver->field_owners, field, i)) {
+                symbol_map_put(&resolver->field_owners, field, module->records_size);
+            }
+        }
+    }
+}
+
+static void resolve_field_access(Resolver* resolver, FieldAccess* field_access) {
+    int owner = symbol_map_get(&resolver->field_owners, field_access->symbol);
+    if (owner < 0) {
+        error_and_die("no such field: "SPAN_FMT, SPAN_ARG(field_access->field));
+    }
+
+    // a field unique to one record has a statically known offset, seed the cache with it.
+    if (owner < resolver->module->records_size) {
+        Record* record = &resolver->module->records[owner];
+
+        field_access->cached_shape = record;
+        field_access->cached_offset = record_find_field(record, field_access->symbol);
+    }
+}
+
+static void resolve_block(Resolver* resolver, Block* block);
+
+static void resolve_expression(Resolver* resolver, Expression* expression) {
+    switch (expression->type) {
+        case EXPR_PRIMARY: {
+            Value* value = &expression->as.primary;
+
+            switch (value->type) {
+                case VAL_IDENT:
+                    value->as.identifier.slot = lookup(resolver, value->as.identifier.symbol, value->as.identifier.id);
+                    break;
+                case VAL_FUNCALL:
+                    for (int i = 0; i < value->as.funcall.args_size; i++) {
+                        resolve_expression(resolver, value->as.funcall.args[i]);
+                    }
+                    break;
+                case VAL_RECORD_CREATION:
+                    for (int i = 0; i < value->as.record_creation.args_size; i++) {
+                        resolve_expression(resolver, value->as.record_creation.args[i]);
+                    }
+                    break;
+                case VAL_FIELD_ACCESS:
+                    resolve_expression(resolver, value->as.field_access.expr);
+                    resolve_field_access(resolver, &value->as.field_access);
+                    break;
+                case VAL_INT:
+                    object_box_literal(resolver->module->arena, value);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        case EXPR_BINARY:
+            resolve_expression(resolver, expression->as.binary.lhs);
+            resolve_expression(resolver, expression->as.binary.rhs);
+            break;
+    }
+}
+
+static void resolve_let_block(Resolver* resolver, LetBlock* letblock) {
+    for (int i = 0; i < letblock->ids_size; i++) {
+        letblock->ids[i].slot = resolver->fundecl->slots_size++;
+        declare(resolver, letblock->ids[i].symbol, letblock->ids[i].slot);
+    }
+
+    for (int i = 0; i < letblock->assignments_size; i++) {
+        Assignment* assignment = &letblock->assignments[i];
+
+        assignment->slot = lookup(resolver, assignment->symbol, assignment->id);
+        resolve_expression(resolver, assignment->expr);
+    }
+}
+
+static void resolve_block(Resolver* resolver, Block* block) {
+    // let bindings are visible until the end of the block they are declared in.
+    int bindings_size = resolver->bindings_size;
+
+    for (int i = 0; i < block->children_size; i++) {
+        Statement* statement = &block->children[i];
+
+        switch (statement->type) {
+            case STMT_LETBLOCK:
+                resolve_let_block(resolver, &statement->as.letblock);
+                break;
+            case STMT_IF:
+                resolve_expression(resolver, statement->as.ifstatement.expr);
+                resolve_block(resolver, statement->as.ifstatement.true_block);
+                resolve_block(resolver, statement->as.ifstatement.false_block);
+                break;
+            case STMT_EXPRESSION:
+                resolve_expression(resolver, statement->as.expression);
+                break;
+        }
+    }
+
+    resolver->bindings_size = bindings_size;
+}
+
+static void resolve_function_declaration(Resolver* resolver, FunctionDeclaration* fundecl) {
+    resolver->fundecl = fundecl;
+    resolver->bindings_size = 0;
+
+    fundecl->slots_size = fundecl->args_size;
+
+    for (int i = 0; i < fundecl->args_size; i++) {
+        declare(resolver, fundecl->args[i].symbol, i);
+    }
+
+    resolve_block(resolver, fundecl->block);
+}
+
+void resolver_init(Resolver* resolver, Module* module) {
+    assert(resolver != NULL);
+    assert(module != NULL);
+
+    resolver->module = module;
+    resolver->fundecl = NULL;
+
+    symbol_map_init(&resolver->field_owners);
+
+    resolver->bindings = NULL;
+    resolver->bindings_size = 0;
+    resolver->bindings_cap = 0;
+}
+
+// also safe on a zeroed resolver, so a failed load can always clean up.
+void resolver_deinit(Resolver* resolver) {
+    assert(resolver != NULL);
+
+    free(resolver->bindings);
+    symbol_map_free(&resolver->field_owners);
+
+    resolver->module = NULL;
+    resolver->fundecl = NULL;
+    resolver->bindings = NULL;
+    resolver->bindings_size = 0;
+    resolver->bindings_cap = 0;
+}
+
+void resolve_module(Resolver* resolver) {
+    assert(resolver != NULL);
+
+    Module* module = resolver->module;
+
+    module_index(module);
+    index_fields(resolver);
+
+    for (int i = 0; i < module->fundecls_size; i++) {
+        resolve_function_declaration(resolver, &module->fundecls[i]);
+    }
+}
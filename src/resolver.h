@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ast.h"
+
+typedef struct {
+    Symbol symbol;
+    int slot;
+} Binding;
+
+typedef struct {
+    Module* module;
+    FunctionDeclaration* fundecl;
+
+    // field symbol -> index of the only record declaring it, or records_size when several do.
+    SymbolMap field_owners;
+
+    Binding* bindings;
+    int bindings_size;
+    int bindings_cap;
+} Resolver;
+
+void resolver_init(Resolver* resolver, Module* module);
+void resolver_deinit(Resolver* resolver);
+
+// indexes the module, then binds every identifier, function argument and let
+// binding to a slot in the frame of its enclosing function declaration.
+void resolve_module(Resolver* resolver);
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "runtime.h"
+
+// both operands are known to have the same type here. the inline int and
+// float cases are tried first, they need no type dispatch.
+#define PERFORM_BINOP(op) \
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {\
+        return heap_make_int(heap, object_as_small_int(lhs) op object_as_small_int(rhs));\
+    }\
+    if (object_is_float(lhs)) {\
+        return object_float(object_as_float(lhs) op object_as_float(rhs));\
+    }\
+    if (object_is_int(lhs)) {\
+        return heap_make_int(heap, object_as_int(lhs) op object_as_int(rhs));\
+    }\
+    error_and_die("user defined types / void doesn't support any binary operator");\
+
+#define PERFORM_BOOLBINOP(op) \
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {\
+        return object_small_int(object_as_small_int(lhs) op object_as_small_int(rhs));\
+    }\
+    if (object_is_float(lhs)) {\
+        return object_small_int(object_as_float(lhs) op object_as_float(rhs));\
+    }\
+    if (object_is_int(lhs)) {\
+        return object_small_int(object_as_int(lhs) op object_as_int(rhs));\
+    }\
+    error_and_die("user defined types / void doesn't support any binary operator");\
+
+Object perform_binary(Heap* heap, BinaryExpressionType type, Object lhs, Object rhs) {
+    if (object_type(lhs) != object_type(rhs)) {
+        error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", object_type(lhs), object_type(rhs));
+    }
+
+    switch (type) {
+        case BIN_ADD: PERFORM_BINOP(+)
+        case BIN_SUB: PERFORM_BINOP(-)
+        case BIN_MUL: PERFORM_BINOP(*)
+        case BIN_DIV: PERFORM_BINOP(/)
+        case BIN_EQU: PERFORM_BOOLBINOP(==)
+        case BIN_NEQU: PERFORM_BOOLBINOP(!=)
+        case BIN_GT: PERFORM_BOOLBINOP(>)
+        case BIN_LT: PERFORM_BOOLBINOP(<)
+        case BIN_GTEQ: PERFORM_BOOLBINOP(>=)
+        case BIN_LTEQ: PERFORM_BOOLBINOP(<=)
+        case BIN_AND: PERFORM_BOOLBINOP(&&)
+        case BIN_OR: PERFORM_BOOLBINOP(||)
+    }
+
+    error_and_die("unreachable");
+}
+
+Runtime runtime;
+
+static void mark_runtime_roots(Heap* heap, void* context) {
+    (void) context;
+
+    heap_mark_objects(heap, runtime.frames, runtime.frames_size);
+}
+
+void runtime_init(void) {
+    runtime.frames = malloc(sizeof(Object) * RUNTIME_FRAMES_MAX);
+    if (!runtime.frames) {
+        error_and_die("cannot allocate memory");
+    }
+
+    runtime.frames_size = 0;
+    runtime.tail = NULL;
+
+    heap_init(&runtime.heap, mark_runtime_roots, NULL);
+}
+
+int runtime_exit(Object result) {
+    if (!object_is_int(result)) {
+        error_and_die("main function should return integer");
+    }
+
+    int return_value = object_as_int(result);
+
+    heap_deinit(&runtime.heap);
+    free(runtime.frames);
+
+    return return_value;
+}
+
+Object runtime_call(RuntimeFunction function, Object* frame) {
+    Object result = function(frame);
+
+    while (runtime.tail) {
+        function = runtime.tail;
+        runtime.tail = NULL;
+
+        result = function(frame);
+    }
+
+    return result;
+}
+
+Object runtime_run(RuntimeFunction main, int frame_size) {
+    Object* frame = runtime_push_frame(frame_size);
+
+    Object result = runtime_call(main, frame);
+    runtime_pop_frame(frame);
+
+    return result;
+}
+
+Object runtime_record(Record* shape, Object* fields) {
+    ObjRecord* record = heap_alloc_record(&runtime.heap, shape);
+    memcpy(record->fields, fields, sizeof(Object) * shape->fields_size);
+
+    return object_record(record);
+}
+
+bool runtime_truthy(Object object) {
+    if (!object_is_int(object)) {
+        error_and_die("if expressions should be boolean");
+    }
+
+    return object_as_int(object) != 0;
+}
+
+void runtime_print(Object object) {
+    object_print(&object);
+    printf("\n");
+}
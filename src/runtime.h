@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "common.h"
+#include "gc.h"
+#include "object.h"
+
+// the generic binary operator, type checked and dispatched on the operand types.
+Object perform_binary(Heap* heap, BinaryExpressionType type, Object lhs, Object rhs);
+
+// everything a program compiled to C by --emit-c needs at run time. it is built
+// into libbasilisk_runtime, which leaves out the lexer, parser and engines.
+
+// frames never move, so compiled functions keep a plain pointer to theirs.
+#define RUNTIME_FRAMES_MAX (1 << 22)
+
+// runs a compiled function on its frame, the arguments are in the first slots.
+typedef Object (*RuntimeFunction)(Object* frame);
+
+typedef struct {
+    Object* frames;
+    int frames_size;
+
+    // set by a call in tail position, which replaced the caller's frame with its own.
+    RuntimeFunction tail;
+
+    // records are collected, the frame stack is the root set.
+    Heap heap;
+} Runtime;
+
+extern Runtime runtime;
+
+void runtime_init(void);
+
+// tears the runtime down and turns the value of main into an exit code.
+int runtime_exit(Object result);
+
+static inline Object* runtime_push_frame(int size) {
+    if (runtime.frames_size + size > RUNTIME_FRAMES_MAX) {
+        error_and_die("stack overflow");
+    }
+
+    Object* frame = &runtime.frames[runtime.frames_size];
+    for (int i = 0; i < size; i++) {
+        frame[i] = object_small_int(0);
+    }
+
+    runtime.frames_size += size;
+
+    return frame;
+}
+
+static inline void runtime_pop_frame(Object* frame) {
+    runtime.frames_size = frame - runtime.frames;
+}
+
+// turns the frame on top of the stack into one of size slots, keeping the arguments.
+static inline void runtime_resize_frame(Object* frame, int args_size, int size) {
+    runtime_pop_frame(&frame[args_size]);
+    (void) runtime_push_frame(size - args_size);
+}
+
+// calls function, then whatever it and its successors hand over through tail calls.
+Object runtime_call(RuntimeFunction function, Object* frame);
+Object runtime_run(RuntimeFunction main, int frame_size);
+
+static inline Object runtime_binary(BinaryExpressionType type, Object lhs, Object rhs) {
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {
+        int64_t a = object_as_small_int(lhs);
+        int64_t b = object_as_small_int(rhs);
+
+        switch (type) {
+            case BIN_ADD: return heap_make_int(&runtime.heap, a + b);
+            case BIN_SUB: return heap_make_int(&runtime.heap, a - b);
+            case BIN_MUL: return heap_make_int(&runtime.heap, a * b);
+            case BIN_DIV: return heap_make_int(&runtime.heap, a / b);
+            case BIN_EQU: return object_small_int(a == b);
+            case BIN_NEQU: return object_small_int(a != b);
+            case BIN_GT: return object_small_int(a > b);
+            case BIN_LT: return object_small_int(a < b);
+            case BIN_GTEQ: return object_small_int(a >= b);
+            case BIN_LTEQ: return object_small_int(a <= b);
+            case BIN_AND: return object_small_int(a && b);
+            case BIN_OR: return object_small_int(a || b);
+        }
+    }
+
+    return perform_binary(&runtime.heap, type, lhs, rhs);
+}
+
+// the fields are read from a frame, so they stay reachable while allocating.
+Object runtime_record(Record* shape, Object* fields);
+
+static inline Object runtime_field(FieldAccess* field_access, Object object) {
+    if (object_is_record(object) && object_as_record(object)->shape == field_access->cached_shape) {
+        return object_as_record(object)->fields[field_access->cached_offset];
+    }
+
+    return object_as_record(object)->fields[object_field_offset(&object, field_access)];
+}
+
+bool runtime_truthy(Object object);
+void runtime_print(Object object);
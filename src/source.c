@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "source.h"
+
+#define SOURCE_READ_CHUNK (64 * 1024)
+
+// reads until end of file, for anything without a size known upfront.
+static bool read_stream(Source* source, int fd) {
+    char* data = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+
+    for (;;) {
+        if (cap - size < SOURCE_READ_CHUNK) {
+            cap = cap ? cap * 2 : SOURCE_READ_CHUNK;
+            char* grown = realloc(data, cap);
+
+            if (!grown) {
+                free(data);
+                return false;
+            }
+
+            data = grown;
+        }
+
+        ssize_t count = read(fd, data + size, cap - size);
+
+        if (count == 0) {
+            break;
+        }
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            free(data);
+            return false;
+        }
+
+        size += count;
+    }
+
+    source->data = data;
+    source->size = size;
+    source->mapped = false;
+
+    return true;
+}
+
+void source_open(Source* source, const char* filepath) {
+    assert(source != NULL);
+    assert(filepath != NULL);
+
+    bool standard_input = strcmp(filepath, "-") == 0;
+
+    int fd = standard_input ? STDIN_FILENO : open(filepath, O_RDONLY);
+    if (fd < 0) {
+        error_and_die("cannot open: %s", filepath);
+    }
+
+    struct stat info;
+    bool valid = fstat(fd, &info) == 0 && !S_ISDIR(info.st_mode);
+
+    // empty files cannot be mapped, files of procfs and the like report no size.
+    void* data = MAP_FAILED;
+    if (valid && S_ISREG(info.st_mode) && info.st_size > 0) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    if (data != MAP_FAILED) {
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+        source->data = data;
+        source->size = info.st_size;
+        source->mapped = true;
+    } else if (valid) {
+        valid = read_stream(source, fd);
+    }
+
+    if (!standard_input) {
+        close(fd);
+    }
+
+    if (!valid) {
+        error_and_die("cannot read: %s", filepath);
+    }
+}
+
+void source_copy(Source* source, const char* data, size_t size) {
+    assert(source != NULL);
+    assert(data != NULL);
+
+    char* copy = malloc(size ? size : 1);
+    if (!copy) {
+        error_and_die("cannot allocate memory");
+    }
+
+    memcpy(copy, data, size);
+
+    source->data = copy;
+    source->size = size;
+    source->mapped = false;
+}
+
+void source_close(Source* source) {
+    assert(source != NULL);
+
+    if (source->mapped) {
+        munmap((void*) source->data, source->size);
+    } else {
+        free((void*) source->data);
+    }
+
+    source->data = NULL;
+    source->size = 0;
+    source->mapped = false;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// the text of a module. regular files are mapped read-only so spans point straight
+// into the page cache, pipes and terminals are read into a heap buffer. either
+// way the data is not zero terminated and must outlive every span into it.
+typedef struct {
+    const char* data;
+    size_t size;
+
+    bool mapped;
+} Source;
+
+// "-" reads standard input. dies if the file cannot be read.
+void source_open(Source* source, const char* filepath);
+
+// takes a copy of size bytes of data.
+void source_copy(Source* source, const char* data, size_t size);
+
+void source_close(Source* source);
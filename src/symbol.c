@@ -0,0 +1,259 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "symbol.h"
+
+typedef struct {
+    Span* spans;
+    uint32_t* hashes;
+    int spans_size;
+    int spans_cap;
+
+    // open addressing, holds symbol + 1 so zero marks an empty bucket.
+    Symbol* buckets;
+    int buckets_cap;
+} SymbolTable;
+
+static SymbolTable s_symbols = {0};
+
+static const char* s_builtins[SYM_BUILTIN_COUNT] = {
+    [SYM_RECORD] = "record",
+    [SYM_DEF] = "def",
+    [SYM_LET] = "let",
+    [SYM_IF] = "if",
+    [SYM_ELSE] = "else",
+    [SYM_PRINT] = "print",
+    [SYM_MAIN] = "main",
+};
+
+static uint32_t hash_span(Span span) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < span.size; i++) {
+        hash ^= (uint8_t) span.data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void symbols_rehash(SymbolTable* table, int buckets_cap) {
+    free(table->buckets);
+
+    table->buckets = calloc(buckets_cap, sizeof(Symbol));
+    table->buckets_cap = buckets_cap;
+
+    if (!table->buckets) {
+        error_and_die("cannot allocate memory");
+    }
+
+    for (int i = 0; i < table->spans_size; i++) {
+        int bucket = table->hashes[i] & (buckets_cap - 1);
+
+        while (table->buckets[bucket]) {
+            bucket = (bucket + 1) & (buckets_cap - 1);
+        }
+
+        table->buckets[bucket] = i + 1;
+    }
+}
+
+static Symbol symbols_insert(SymbolTable* table, Span span, uint32_t hash, int bucket) {
+    if (table->spans_size >= table->spans_cap) {
+        table->spans_cap = table->spans_cap ? table->spans_cap * 2 : 64;
+        table->spans = realloc(table->spans, sizeof(Span) * table->spans_cap);
+        table->hashes = realloc(table->hashes, sizeof(uint32_t) * table->spans_cap);
+
+        if (!table->spans || !table->hashes) {
+            error_and_die("cannot allocate memory");
+        }
+    }
+
+    // symbols outlive the source buffer they were found in.
+    char* data = malloc(span.size + 1);
+    if (!data) {
+        error_and_die("cannot allocate memory");
+    }
+
+    memcpy(data, span.data, span.size);
+    data[span.size] = 0;
+
+    Symbol symbol = table->spans_size++;
+
+    table->spans[symbol] = span_make(data, span.size);
+    table->hashes[symbol] = hash;
+    table->buckets[bucket] = symbol + 1;
+
+    // keep the load factor under one half.
+    if (table->spans_size * 2 > table->buckets_cap) {
+        symbols_rehash(table, table->buckets_cap * 2);
+    }
+
+    return symbol;
+}
+
+static Symbol symbols_lookup_or_insert(SymbolTable* table, Span span) {
+    uint32_t hash = hash_span(span);
+    int bucket = hash & (table->buckets_cap - 1);
+
+    while (table->buckets[bucket]) {
+        Symbol symbol = table->buckets[bucket] - 1;
+
+        if (table->hashes[symbol] == hash && span_equals(table->spans[symbol], span)) {
+            return symbol;
+        }
+
+        bucket = (bucket + 1) & (table->buckets_cap - 1);
+    }
+
+    return symbols_insert(table, span, hash, bucket);
+}
+
+static void symbols_init(SymbolTable* table) {
+    symbols_rehash(table, 128);
+
+    for (int i = 0; i < SYM_BUILTIN_COUNT; i++) {
+        Symbol symbol = symbols_lookup_or_insert(table, span_from_cstr(s_builtins[i]));
+        assert(symbol == i);
+        (void) symbol;
+    }
+}
+
+static int symbol_hash(Symbol symbol, int cap) {
+    // fibonacci hashing, symbols are small dense integers. the high bits of the
+    // product are the well mixed ones, cap is a power of two.
+    return ((uint64_t) symbol * 11400714819323198485ull) >> (64 - __builtin_ctz(cap));
+}
+
+void symbol_map_init(SymbolMap* map) {
+    assert(map != NULL);
+
+    map->keys = NULL;
+    map->values = NULL;
+    map->size = 0;
+    map->cap = 0;
+}
+
+void symbol_map_free(SymbolMap* map) {
+    assert(map != NULL);
+
+    free(map->keys);
+    free(map->values);
+
+    symbol_map_init(map);
+}
+
+static void symbol_map_grow(SymbolMap* map) {
+    Symbol* keys = map->keys;
+    int* values = map->values;
+    int cap = map->cap;
+
+    map->cap = cap ? cap * 2 : 16;
+    map->keys = malloc(sizeof(Symbol) * map->cap);
+    map->values = malloc(sizeof(int) * map->cap);
+
+    if (!map->keys || !map->values) {
+        error_and_die("cannot allocate memory");
+    }
+
+    for (int i = 0; i < map->cap; i++) {
+        map->keys[i] = SYMBOL_NONE;
+    }
+
+    for (int i = 0; i < cap; i++) {
+        if (keys[i] == SYMBOL_NONE)
+            continue;
+
+        int bucket = symbol_hash(keys[i], map->cap);
+        while (map->keys[bucket] != SYMBOL_NONE) {
+            bucket = (bucket + 1) & (map->cap - 1);
+        }
+
+        map->keys[bucket] = keys[i];
+        map->values[bucket] = values[i];
+    }
+
+    free(keys);
+    free(values);
+}
+
+bool symbol_map_insert(SymbolMap* map, Symbol key, int value) {
+    assert(map != NULL);
+    assert(key != SYMBOL_NONE);
+
+    if ((map->size + 1) * 2 > map->cap) {
+        symbol_map_grow(map);
+    }
+
+    int bucket = symbol_hash(key, map->cap);
+    while (map->keys[bucket] != SYMBOL_NONE) {
+        if (map->keys[bucket] == key) {
+            return false;
+        }
+
+        bucket = (bucket + 1) & (map->cap - 1);
+    }
+
+    map->keys[bucket] = key;
+    map->values[bucket] = value;
+    map->size++;
+
+    return true;
+}
+
+void symbol_map_put(SymbolMap* map, Symbol key, int value) {
+    if (symbol_map_insert(map, key, value))
+        return;
+
+    int bucket = symbol_hash(key, map->cap);
+    while (map->keys[bucket] != key) {
+        bucket = (bucket + 1) & (map->cap - 1);
+    }
+
+    map->values[bucket] = value;
+}
+
+int symbol_map_get(SymbolMap* map, Symbol key) {
+    if (map->size == 0)
+        return -1;
+
+    int bucket = symbol_hash(key, map->cap);
+    while (map->keys[bucket] != SYMBOL_NONE) {
+        if (map->keys[bucket] == key) {
+            return map->values[bucket];
+        }
+
+        bucket = (bucket + 1) & (map->cap - 1);
+    }
+
+    return -1;
+}
+
+Symbol symbol_intern(Span span) {
+    if (!s_symbols.buckets) {
+        symbols_init(&s_symbols);
+    }
+
+    return symbols_lookup_or_insert(&s_symbols, span);
+}
+
+Span symbol_span(Symbol symbol) {
+    assert(symbol >= 0 && symbol < s_symbols.spans_size);
+
+    return s_symbols.spans[symbol];
+}
+
+void symbols_free() {
+    for (int i = 0; i < s_symbols.spans_size; i++) {
+        free((char*) s_symbols.spans[i].data);
+    }
+
+    free(s_symbols.spans);
+    free(s_symbols.hashes);
+    free(s_symbols.buckets);
+
+    s_symbols = (SymbolTable) {0};
+}
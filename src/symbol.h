@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "span.h"
+
+// an interned identifier, two symbols are the same name iff they are equal.
+typedef int32_t Symbol;
+
+#define SYMBOL_NONE (-1)
+
+// symbols known ahead of time, interned in this order before anything else.
+enum {
+    SYM_RECORD,
+    SYM_DEF,
+    SYM_LET,
+    SYM_IF,
+    SYM_ELSE,
+
+    SYM_PRINT,
+    SYM_MAIN,
+
+    SYM_BUILTIN_COUNT,
+};
+
+// open addressing map from a symbol to a non negative integer.
+typedef struct {
+    Symbol* keys;
+    int* values;
+    int size;
+    int cap;
+} SymbolMap;
+
+void symbol_map_init(SymbolMap* map);
+void symbol_map_free(SymbolMap* map);
+
+// returns false if the symbol is already in the map.
+bool symbol_map_insert(SymbolMap* map, Symbol key, int value);
+void symbol_map_put(SymbolMap* map, Symbol key, int value);
+int symbol_map_get(SymbolMap* map, Symbol key);
+
+Symbol symbol_intern(Span span);
+Span symbol_span(Symbol symbol);
+
+void symbols_free();
@@ -1,10 +1,119 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
 #include "token.h"
 
-Token token_make(int line, int col, TokenType type, Span span) {
-    return (Token) {
-        .line = line,
-        .col = col,
-        .type = type,
-        .span = span,
-    };
+void tokens_init(Tokens* tokens, const char* source, size_t source_size) {
+    assert(tokens != NULL);
+    assert(source != NULL);
+
+    if (source_size >= UINT32_MAX) {
+        error_and_die("source too large: %zu bytes", source_size);
+    }
+
+    tokens->source = source;
+    tokens->source_size = source_size;
+
+    tokens->types = NULL;
+    tokens->offsets = NULL;
+    tokens->sizes = NULL;
+    tokens->symbols = NULL;
+    tokens->size = 0;
+    tokens->cap = 0;
+
+    tokens->line_starts = NULL;
+    tokens->line_starts_size = 0;
+}
+
+void tokens_free(Tokens* tokens) {
+    assert(tokens != NULL);
+
+    free(tokens->types);
+    free(tokens->offsets);
+    free(tokens->sizes);
+    free(tokens->symbols);
+    free(tokens->line_starts);
+
+    tokens->types = NULL;
+    tokens->offsets = NULL;
+    tokens->sizes = NULL;
+    tokens->symbols = NULL;
+    tokens->size = 0;
+    tokens->cap = 0;
+
+    tokens->line_starts = NULL;
+    tokens->line_starts_size = 0;
+}
+
+void tokens_grow(Tokens* tokens, int cap) {
+    assert(cap >= tokens->size);
+
+    tokens->types = realloc(tokens->types, sizeof(uint8_t) * cap);
+    tokens->offsets = realloc(tokens->offsets, sizeof(uint32_t) * cap);
+    tokens->sizes = realloc(tokens->sizes, sizeof(uint32_t) * cap);
+    tokens->symbols = realloc(tokens->symbols, sizeof(Symbol) * cap);
+
+    if (!tokens->types || !tokens->offsets || !tokens->sizes || !tokens->symbols) {
+        error_and_die("cannot allocate memory");
+    }
+
+    tokens->cap = cap;
+}
+
+static void find_line_starts(Tokens* tokens) {
+    int cap = 1024;
+
+    tokens->line_starts = malloc(sizeof(uint32_t) * cap);
+    if (!tokens->line_starts) {
+        error_and_die("cannot allocate memory");
+    }
+
+    tokens->line_starts[tokens->line_starts_size++] = 0;
+
+    const char* p = tokens->source;
+    const char* end = tokens->source + tokens->source_size;
+
+    while ((p = memchr(p, '\n', end - p))) {
+        p++;
+
+        if (tokens->line_starts_size >= cap) {
+            cap *= 2;
+            tokens->line_starts = realloc(tokens->line_starts, sizeof(uint32_t) * cap);
+
+            if (!tokens->line_starts) {
+                error_and_die("cannot allocate memory");
+            }
+        }
+
+        tokens->line_starts[tokens->line_starts_size++] = p - tokens->source;
+    }
+}
+
+void tokens_position(Tokens* tokens, const char* at, int* line, int* col) {
+    assert(at >= tokens->source && at <= tokens->source + tokens->source_size);
+
+    if (!tokens->line_starts) {
+        find_line_starts(tokens);
+    }
+
+    uint32_t offset = at - tokens->source;
+
+    // the last line starting at or before offset.
+    int lo = 0;
+    int hi = tokens->line_starts_size - 1;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+
+        if (tokens->line_starts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    *line = lo + 1;
+    *col = offset - tokens->line_starts[lo] + 1;
 }
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "span.h"
+#include "symbol.h"
 
 typedef enum {
     TOK_INTLITERAL,
@@ -39,13 +43,70 @@ typedef enum {
     TOK_MINUS,
     TOK_STAR,
     TOK_SLASH,
+
+    TOK_EOF, // past the last token, never stored
 } TokenType;
 
+// one token read back from a token buffer.
 typedef struct {
-    int line;
-    int col;
     TokenType type;
     Span span;
+    Symbol symbol; // identifiers and keywords only
 } Token;
 
-Token token_make(int line, int col, TokenType type, Span span);
+// the tokens of one source as parallel arrays, thirteen bytes a token. positions
+// are byte offsets into the source, lines and columns are only worked out when an
+// error message asks for them.
+typedef struct {
+    const char* source;
+    size_t source_size;
+
+    uint8_t* types;
+    uint32_t* offsets;
+    uint32_t* sizes;
+    Symbol* symbols;
+    int size;
+    int cap;
+
+    // offset of the start of every line, built on the first position asked for.
+    uint32_t* line_starts;
+    int line_starts_size;
+} Tokens;
+
+// sources must be smaller than 4G, offsets are 32 bits.
+void tokens_init(Tokens* tokens, const char* source, size_t source_size);
+void tokens_free(Tokens* tokens);
+
+void tokens_grow(Tokens* tokens, int cap);
+
+static inline void tokens_push(Tokens* tokens, TokenType type, const char* start, int size, Symbol symbol) {
+    if (tokens->size >= tokens->cap) {
+        tokens_grow(tokens, tokens->cap ? tokens->cap * 2 : 1024);
+    }
+
+    int index = tokens->size++;
+
+    tokens->types[index] = type;
+    tokens->offsets[index] = start - tokens->source;
+    tokens->sizes[index] = size;
+    tokens->symbols[index] = symbol;
+}
+
+static inline Token tokens_get(Tokens* tokens, int index) {
+    if (index >= tokens->size) {
+        return (Token) {
+            .type = TOK_EOF,
+            .span = span_make(tokens->source + tokens->source_size, 0),
+            .symbol = SYMBOL_NONE,
+        };
+    }
+
+    return (Token) {
+        .type = tokens->types[index],
+        .span = span_make(tokens->source + tokens->offsets[index], tokens->sizes[index]),
+        .symbol = tokens->symbols[index],
+    };
+}
+
+// line and column, both from one, of a character of the source.
+void tokens_position(Tokens* tokens, const char* at, int* line, int* col);
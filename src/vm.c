@@ -0,0 +1,314 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "vm.h"
+
+#define READ_U16() (ip += 2, (uint16_t) (ip[-2] | (ip[-1] << 8)))
+
+#define CHECK_OPERANDS() \
+    if (object_type(lhs) != object_type(rhs)) { \
+        error_and_die("mismatched types for binary operator\n    lhs: %d\n    rhs: %d", object_type(lhs), object_type(rhs));\
+    }\
+
+// inline ints and floats are handled before any type dispatch, boxing an
+// overflowing int may collect so the stack is published first.
+#define VM_BINOP(op) { \
+    Object rhs = *--sp;\
+    Object lhs = sp[-1];\
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {\
+        int64_t result = object_as_small_int(lhs) op object_as_small_int(rhs);\
+        if (object_fits_small_int(result)) {\
+            sp[-1] = object_small_int(result);\
+            break;\
+        }\
+    } else if (object_is_float(lhs) && object_is_float(rhs)) {\
+        sp[-1] = object_float(object_as_float(lhs) op object_as_float(rhs));\
+        break;\
+    }\
+    CHECK_OPERANDS()\
+    if (!object_is_int(lhs)) {\
+        error_and_die("user defined types / void doesn't support any binary operator");\
+    }\
+    vm->stack_size = sp - vm->stack;\
+    sp[-1] = heap_make_int(&vm->heap, object_as_int(lhs) op object_as_int(rhs));\
+    break;\
+}\
+
+#define VM_BOOLBINOP(op) { \
+    Object rhs = *--sp;\
+    Object lhs = sp[-1];\
+    if (object_is_small_int(lhs) && object_is_small_int(rhs)) {\
+        sp[-1] = object_small_int(object_as_small_int(lhs) op object_as_small_int(rhs));\
+        break;\
+    }\
+    CHECK_OPERANDS()\
+    switch (object_type(lhs)) {\
+        case OBJ_INT:\
+            sp[-1] = object_small_int(object_as_int(lhs) op object_as_int(rhs));\
+            break;\
+        case OBJ_FLOAT:\
+            sp[-1] = object_small_int(object_as_float(lhs) op object_as_float(rhs));\
+            break;\
+        default:\
+            error_and_die("user defined types / void doesn't support any binary operator");\
+    }\
+    break;\
+}\
+
+static void vm_reserve_stack(VM* vm, int size) {
+    if (size <= vm->stack_cap)
+        return;
+
+    while (vm->stack_cap < size) {
+        vm->stack_cap = vm->stack_cap ? vm->stack_cap * 2 : 1024;
+    }
+
+    vm->stack = realloc(vm->stack, sizeof(Object) * vm->stack_cap);
+    if (!vm->stack) {
+        error_and_die("cannot allocate memory");
+    }
+
+    vm->stats.allocations++;
+}
+
+static CallFrame* vm_push_frame(VM* vm, BytecodeFunction* function, int base) {
+    if (vm->frames_size >= vm->frames_cap) {
+        vm->frames_cap = vm->frames_cap ? vm->frames_cap * 2 : 256;
+        vm->frames = realloc(vm->frames, sizeof(CallFrame) * vm->frames_cap);
+        if (!vm->frames) {
+            error_and_die("cannot allocate memory");
+        }
+
+        vm->stats.allocations++;
+    }
+
+    vm_reserve_stack(vm, base + function->slots_size + function->stack_size);
+
+    if (base + function->slots_size > vm->stats.frames_peak) {
+        vm->stats.frames_peak = base + function->slots_size;
+    }
+
+    vm->stats.calls++;
+
+    CallFrame* frame = &vm->frames[vm->frames_size++];
+    frame->function = function;
+    frame->ip = function->code;
+    frame->base = base;
+
+    return frame;
+}
+
+// the fields must still be on the stack, below vm->stack_size.
+static Object vm_make_record(VM* vm, int index, Object* fields) {
+    Record* record = &vm->program->module->records[index];
+
+    ObjRecord* objrecord = heap_alloc_record(&vm->heap, record);
+    memcpy(objrecord->fields, fields, sizeof(Object) * record->fields_size);
+
+    vm->stats.allocations++;
+
+    return object_record(objrecord);
+}
+
+static void mark_vm_roots(Heap* heap, void* context) {
+    VM* vm = context;
+
+    heap_mark_objects(heap, vm->stack, vm->stack_size);
+}
+
+// let bindings may be read by the collector before they are assigned.
+static void clear_slots(Object* slots, int from, int to) {
+    for (int i = from; i < to; i++) {
+        slots[i] = object_small_int(0);
+    }
+}
+
+void vm_init(VM* vm, Program* program) {
+    assert(vm != NULL);
+    assert(program != NULL);
+
+    vm->program = program;
+
+    vm->stack = NULL;
+    vm->stack_size = 0;
+    vm->stack_cap = 0;
+
+    vm->frames = NULL;
+    vm->frames_size = 0;
+    vm->frames_cap = 0;
+
+    heap_init(&vm->heap, mark_vm_roots, vm);
+
+    vm->stats = (InterpreterStats) {0};
+}
+
+void vm_deinit(VM* vm) {
+    assert(vm != NULL);
+
+    if (vm->stack) {
+        free(vm->stack);
+    }
+
+    if (vm->frames) {
+        free(vm->frames);
+    }
+
+    heap_deinit(&vm->heap);
+}
+
+Object vm_run(VM* vm) {
+    Program* program = vm->program;
+    BytecodeFunction* entry_point = &program->functions[program->entry_point];
+
+    CallFrame* frame = vm_push_frame(vm, entry_point, 0);
+
+    for (int i = 0; i < entry_point->args_size; i++) {
+        vm->stack[i] = object_void();
+    }
+
+    clear_slots(vm->stack, entry_point->args_size, entry_point->slots_size);
+
+    uint8_t* ip = frame->ip;
+    Object* constants = frame->function->constants;
+    Object* slots = vm->stack;
+    Object* sp = slots + entry_point->slots_size;
+
+    for (;;) {
+        switch (*ip++) {
+            case OP_CONST:
+                *sp++ = constants[READ_U16()];
+                break;
+            case OP_LOAD:
+                *sp++ = slots[READ_U16()];
+                break;
+            case OP_STORE:
+                slots[READ_U16()] = *--sp;
+                break;
+            case OP_RESET:
+                slots[READ_U16()] = object_small_int(0);
+                break;
+            case OP_POP:
+                sp--;
+                break;
+            case OP_ADD: VM_BINOP(+)
+            case OP_SUB: VM_BINOP(-)
+            case OP_MUL: VM_BINOP(*)
+            case OP_DIV: VM_BINOP(/)
+            case OP_EQU: VM_BOOLBINOP(==)
+            case OP_NEQU: VM_BOOLBINOP(!=)
+            case OP_GT: VM_BOOLBINOP(>)
+            case OP_LT: VM_BOOLBINOP(<)
+            case OP_GTEQ: VM_BOOLBINOP(>=)
+            case OP_LTEQ: VM_BOOLBINOP(<=)
+            case OP_AND: VM_BOOLBINOP(&&)
+            case OP_OR: VM_BOOLBINOP(||)
+            case OP_JUMP: {
+                uint16_t offset = READ_U16();
+                ip += offset;
+                break;
+            }
+            case OP_JUMP_IF_FALSE: {
+                uint16_t offset = READ_U16();
+                Object condition = *--sp;
+
+                if (!object_is_int(condition)) {
+                    error_and_die("if expressions should be boolean");
+                }
+
+                if (!object_as_int(condition)) {
+                    ip += offset;
+                }
+                break;
+            }
+            case OP_CALL: {
+                BytecodeFunction* function = &program->functions[READ_U16()];
+                int base = (sp - vm->stack) - function->args_size;
+
+                frame->ip = ip;
+                frame = vm_push_frame(vm, function, base);
+
+                ip = frame->ip;
+                constants = function->constants;
+                slots = vm->stack + base;
+                sp = slots + function->slots_size;
+
+                clear_slots(slots, function->args_size, function->slots_size);
+                break;
+            }
+            case OP_TAIL_CALL: {
+                BytecodeFunction* function = &program->functions[READ_U16()];
+
+                sp -= function->args_size;
+                for (int i = 0; i < function->args_size; i++) {
+                    slots[i] = sp[i];
+                }
+
+                vm_reserve_stack(vm, frame->base + function->slots_size + function->stack_size);
+
+                frame->function = function;
+                vm->stats.calls++;
+
+                ip = function->code;
+                constants = function->constants;
+                slots = vm->stack + frame->base;
+                sp = slots + function->slots_size;
+
+                clear_slots(slots, function->args_size, function->slots_size);
+                break;
+            }
+            case OP_PRINT:
+                object_print(&sp[-1]);
+                printf("\n");
+
+                sp[-1] = object_void();
+                break;
+            case OP_RECORD: {
+                int index = READ_U16();
+                int fields_size = program->module->records[index].fields_size;
+
+                vm->stack_size = sp - vm->stack;
+                Object record = vm_make_record(vm, index, sp - fields_size);
+
+                sp -= fields_size;
+                *sp++ = record;
+                break;
+            }
+            case OP_GET_FIELD: {
+                FieldAccess* field_access = frame->function->field_accesses[READ_U16()];
+                Object object = sp[-1];
+
+                if (object_is_record(object) && object_as_record(object)->shape == field_access->cached_shape) {
+                    sp[-1] = object_as_record(object)->fields[field_access->cached_offset];
+                } else {
+                    vm->stats.field_cache_misses++;
+                    sp[-1] = object_as_record(object)->fields[object_field_offset(&object, field_access)];
+                }
+                break;
+            }
+            case OP_RETURN: {
+                Object result = sp[-1];
+
+                vm->frames_size--;
+                if (vm->frames_size == 0) {
+                    return result;
+                }
+
+                sp = slots;
+                *sp++ = result;
+
+                frame = &vm->frames[vm->frames_size - 1];
+                ip = frame->ip;
+                constants = frame->function->constants;
+                slots = vm->stack + frame->base;
+                break;
+            }
+            case OP_ERROR:
+                error_and_die("%s", frame->function->errors[READ_U16()]);
+            default:
+                error_and_die("unreachable");
+        }
+    }
+}
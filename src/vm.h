@@ -0,0 +1,33 @@
+#pragma once
+
+#include "bytecode.h"
+#include "gc.h"
+#include "interpreter.h"
+
+typedef struct {
+    BytecodeFunction* function;
+    uint8_t* ip;
+    int base;
+} CallFrame;
+
+typedef struct {
+    Program* program;
+
+    Object* stack;
+    int stack_size;
+    int stack_cap;
+
+    CallFrame* frames;
+    int frames_size;
+    int frames_cap;
+
+    // records are collected, the value stack is the root set.
+    Heap heap;
+
+    InterpreterStats stats;
+} VM;
+
+void vm_init(VM* vm, Program* program);
+void vm_deinit(VM* vm);
+
+Object vm_run(VM* vm);
@@ -0,0 +1,45 @@
+# runs one regression program and compares what it prints, its output followed
+# by its errors, with the expected file.
+#
+#   cmake -DBASILISK=... -DPROGRAM=... -DEXPECTED=... [-DARGS="..."] [-DMODE=...] -P run.cmake
+#
+# MODE is run, the default, reparse to run the --dump-ast output of the program
+# instead, or emit-c to run the --emit-c output compiled with CC against RUNTIME,
+# warnings being errors.
+
+separate_arguments(ARGS UNIX_COMMAND "${ARGS}")
+
+get_filename_component(name ${PROGRAM} NAME_WE)
+set(work ${CMAKE_CURRENT_BINARY_DIR}/${name}_${MODE})
+
+if(NOT MODE OR MODE STREQUAL "run")
+    set(command ${BASILISK} ${ARGS} ${PROGRAM})
+elseif(MODE STREQUAL "reparse")
+    execute_process(COMMAND ${BASILISK} ${ARGS} --dump-ast ${PROGRAM} OUTPUT_FILE ${work}.bsl RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "--dump-ast failed: ${status}")
+    endif()
+
+    set(command ${BASILISK} ${work}.bsl)
+elseif(MODE STREQUAL "emit-c")
+    execute_process(COMMAND ${BASILISK} ${ARGS} --emit-c ${PROGRAM} OUTPUT_FILE ${work}.c RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "--emit-c failed: ${status}")
+    endif()
+
+    execute_process(COMMAND ${CC} -Wall -Wextra -Werror -I${INCLUDE} ${work}.c ${RUNTIME} -lm -o ${work} RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "cannot compile the emitted C: ${status}")
+    endif()
+
+    set(command ${work})
+else()
+    message(FATAL_ERROR "unknown mode: ${MODE}")
+endif()
+
+execute_process(COMMAND ${command} OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+file(READ ${EXPECTED} expected)
+
+if(NOT "${output}${errors}" STREQUAL "${expected}")
+    message(FATAL_ERROR "expected:\n${expected}\ngot:\n${output}${errors}")
+endif()